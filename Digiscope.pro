@@ -6,7 +6,7 @@
 
 QT       += core gui network
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 TARGET = Digiscope
 TEMPLATE = app
@@ -21,7 +21,24 @@ SOURCES += \
     src/connectdialog.cpp \
     src/equationdialog.cpp \
     src/parser.cpp \
-    src/voltagepicker.cpp
+    src/voltagepicker.cpp \
+    src/simd.cpp \
+    src/sampleunpack.cpp \
+    src/waveform.cpp \
+    src/waveformdata.cpp \
+    src/minmaxpyramid.cpp \
+    src/firfilter.cpp \
+    src/biquadcascade.cpp \
+    src/fftplancache.cpp \
+    src/spectrum.cpp \
+    src/frequencymeter.cpp \
+    src/samplestats.cpp \
+    src/pulsestats.cpp \
+    src/bytecode.cpp \
+    src/interpolator.cpp \
+    src/dspfiltercache.cpp \
+    src/cicdecimator.cpp \
+    src/parallel.cpp
 
 HEADERS  += \
     include/mainwindow.h \
@@ -34,7 +51,26 @@ HEADERS  += \
     include/parser.h \
     include/equationdefinitions.h \
     include/statedefinitions.h \
-    include/voltagepicker.h
+    include/voltagepicker.h \
+    include/simd.h \
+    include/sampleunpack.h \
+    include/waveform.h \
+    include/waveformdata.h \
+    include/envelope.h \
+    include/minmaxpyramid.h \
+    include/firfilter.h \
+    include/biquadcascade.h \
+    include/fftplancache.h \
+    include/spectrum.h \
+    include/frequencymeter.h \
+    include/samplestats.h \
+    include/pulsestats.h \
+    include/measurements.h \
+    include/bytecode.h \
+    include/interpolator.h \
+    include/dspfiltercache.h \
+    include/cicdecimator.h \
+    include/parallel.h
 
 FORMS    += \
     forms/mainwindow.ui \
@@ -0,0 +1,38 @@
+#ifndef BIQUADCASCADE_H
+#define BIQUADCASCADE_H
+
+#include <complex>
+
+#include <QList>
+#include <QVector>
+#include <QMetaType>
+
+// A second order filter section,
+// H(z) = (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2).
+struct Biquad
+{
+    double b0, b1, b2, a1, a2;
+};
+
+// An IIR filter factored into cascaded second order sections. Factoring a
+// high order filter once when it is loaded keeps it numerically stable and
+// makes the cost of each sample constant per section.
+class BiquadCascade
+{
+public:
+    BiquadCascade();
+    bool design(const QList<double>&, const QList<double>&);
+    bool isEmpty() const;
+    int sections() const;
+    const QVector<Biquad>& coefficients() const;
+    void process(const float*, float*, int) const;
+
+private:
+    static bool findRoots(const QVector<double>&, QVector<std::complex<double> >*);
+    static QVector<QVector<double> > pairFactors(QVector<std::complex<double> >, int);
+    QVector<Biquad> sections_;
+};
+
+Q_DECLARE_METATYPE(BiquadCascade)
+
+#endif // BIQUADCASCADE_H
@@ -0,0 +1,61 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QtMath>
+
+#include <cstring>
+
+#include <simd.h>
+#include <fftplancache.h>
+
+// Number of samples each instruction is run over at a time. The registers of
+// a block stay in the cache while every instruction is run over them.
+#define BYTECODE_BLOCK 256
+
+// Largest integer exponent raised by repeated multiplication.
+#define MAX_INTEGER_POWER 16
+
+// Operations of a compiled math channel expression. CALL_DIFF, CALL_INTEG
+// and CALL_AVG keep state from one sample to the next, CALL_FFT transforms
+// the whole frame at once.
+typedef enum {LOAD_A, LOAD_B, LOAD_F, LOAD_CONST, ADD, SUB, MUL, DIV, POW, NEG,
+              CALL_ABS, CALL_SQRT, CALL_LOG, CALL_SIN,
+              CALL_DIFF, CALL_INTEG, CALL_AVG, CALL_FFT} OpCode;
+
+// An instruction that stores the result of its operation on the left and
+// right registers, or on its value, in the destination register. The value
+// of CALL_AVG is the number of samples averaged.
+struct Instruction
+{
+    OpCode code;
+    int dest, left, right;
+    double value;
+};
+
+// A compiled math channel expression. The program is run over blocks of
+// samples, each instruction operating on a whole block of its registers
+// before the next is run. LOAD instructions refer to the block of their
+// input directly rather than copying it. Programs that transform the whole
+// frame are run as a single block.
+class Bytecode
+{
+public:
+    Bytecode();
+    void clear();
+    void append(const Instruction&);
+    void setResult(int);
+    bool isEmpty() const;
+    int size() const;
+    QStringList listing() const;
+    void run(const float*, const float*, const float*, float*, int, double) const;
+
+private:
+    QVector<Instruction> code_;
+    int registers_, result_;
+    bool wholeFrame_;
+};
+
+#endif // BYTECODE_H
@@ -4,14 +4,17 @@
 #include <math.h>
 
 #include <QPainter>
+#include <QPolygonF>
 #include <QRectF>
 #include <QVector>
 #include <QDebug>
 #include <QtMath>
 #include <QObject>
 #include <QMutex>
+#include <QAtomicInteger>
 
 #include <qwt_plot_curve.h>
+#include <qwt_painter.h>
 #include <qwt_plot.h>
 #include <qwt_scale_map.h>
 #include <qwt_transform.h>
@@ -22,12 +25,31 @@
 
 #include <state.h>
 #include <parser.h>
+#include <waveform.h>
+#include <waveformdata.h>
+#include <envelope.h>
+#include <minmaxpyramid.h>
+#include <firfilter.h>
+#include <interpolator.h>
+#include <dspfiltercache.h>
+#include <cicdecimator.h>
+#include <parallel.h>
+#include <fftplancache.h>
+#include <spectrum.h>
+#include <frequencymeter.h>
+#include <samplestats.h>
+#include <pulsestats.h>
+#include <measurements.h>
 
 #define MAX_FREQ 20000000
 
+// Minimum length of the carrier table, which holds whole periods of the
+// carrier so that it is mixed in long vectorised runs.
+#define MIN_CARRIER_TABLE 256
+
 // A Class to manage the processing and plotting of channel voltage data,
-// each ChannelCurve instance corresponds to a Digiscope channel, and will
-// operate on its own thread.
+// each ChannelCurve instance corresponds to a Digiscope channel, and its
+// frames are processed one at a time on the shared thread pool.
 class ChannelCurve : public QObject, public QwtPlotCurve
 {
     Q_OBJECT
@@ -48,34 +70,56 @@ public:
     void setTimeDiv(double);
     bool selected() const;
     bool isEmpty() const;
+    void request(quint64);
 
 private:
     // Private processing functions.
     void setSamples();
     void processSamples();
+    const QVector<double>& carrier(int);
+    static Waveform peaks(const Waveform&, int);
     void evaluate();
     void filter();
     void measureCurve();
-    void findFrequency();
-    Parser* parser_;
+    void emitMeasurements();
+    void setWaveform(const Waveform&);
+    bool drawEnvelope(QPainter*, const QwtScaleMap&, const QwtScaleMap&) const;
+    Parser parser_;
     Channel channel_;
     bool selected_;
     double voltageDiv_, timeDiv_;
-    State state_;
+    StateSnapshot state_;
+    Waveform waveform_;
+    MinMaxPyramid pyramid_;
+    FirFilter fir_;
+    Interpolator interpolator_;
+    QVector<double> carrier_;
+    DspFilterCache filters_;
+    CicDecimator decimator_;
+    int carrierPeriod_;
+    Spectrum spectrum_;
+    FrequencyMeter frequencyMeter_;
     QMutex mutex_;
+    mutable QMutex pyramidMutex_;
+    Measurements measurements_;
+    int measuredSamples_;
+    QMutex measurementsMutex_;
+    quint64 generation_;
+    QAtomicInteger<quint64> requested_;
 
 public slots:
     // Functions that interact with the GUI thread and process or plot data.
-    void process(State);
+    void process(StateSnapshot, quint64);
     void draw(QPainter*, const QwtScaleMap&, const QwtScaleMap&,
               const QRectF&) const;
 
 signals:
     // Functions that interact with the GUI thread to provide processed data.
-    void plotReady(int, QVector<QPointF>);
-    void measured(int, double, double, double, double, double);
-    void freqCalculated(int, double);
+    void plotReady(int, Waveform, quint64);
+    void measured(int, Measurements);
+    void spectrumReady(int, Waveform);
     void error(QString);
+    void finished(int, quint64);
 
 };
 
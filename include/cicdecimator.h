@@ -0,0 +1,34 @@
+#ifndef CICDECIMATOR_H
+#define CICDECIMATOR_H
+
+#include <QtGlobal>
+#include <QtMath>
+
+// Number of integrator and comb stages of the decimator.
+#define CIC_STAGES 4
+
+// Largest decimation factor, the integrators grow by CIC_STAGES bits for
+// each doubling of the factor and must fit the fixed point samples in 64
+// bits.
+#define MAX_CIC_FACTOR 1024
+
+// Fixed point scale of the integrated samples.
+#define CIC_SCALE 65536.0
+
+// A cascaded integrator-comb decimator. Samples are integrated in fixed point
+// with wrapping unsigned arithmetic, so the integrators never lose precision
+// however long the frame, and the combs only run once per output sample.
+class CicDecimator
+{
+public:
+    CicDecimator();
+    void setFactor(int);
+    int factor() const;
+    double delay() const;
+    int process(const double*, int, float*) const;
+
+private:
+    int factor_;
+};
+
+#endif // CICDECIMATOR_H
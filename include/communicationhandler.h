@@ -12,11 +12,14 @@
 
 #include <QTcpSocket>
 #include <QDataStream>
+#include <QByteArray>
+#include <QtEndian>
 #include <QDebug>
 #include <QTimer>
 #include <QAbstractButton>
 
 #include <state.h>
+#include <sampleunpack.h>
 
 typedef enum {HANDSHAKE,
               RUN,
@@ -56,9 +59,15 @@ public:
 private:
     QTcpSocket* socket_;
     QDataStream stream_;
+    QByteArray buffer_;
+    QVector<quint16> packet_;
     State* state_;
-    bool connected_;
-    QTimer* readTimer_, *keepAliveTimer_;
+    bool connected_, decoding_;
+    QTimer* keepAliveTimer_;
+
+    // Functions to frame and decode messages from the receive buffer.
+    int messageLength(const uchar*, int) const;
+    void decode(const uchar*);
 
 public slots:
     // Slots connected to GUI widget signals that are emitted when
@@ -0,0 +1,41 @@
+#ifndef DSPFILTERCACHE_H
+#define DSPFILTERCACHE_H
+
+#include <QHash>
+
+#include <DspFilters/dsp.h>
+
+// Number of designs kept before the cache is emptied.
+#define MAX_CACHED_FILTERS 8
+
+// Highest order of the bandpass designs, the order DSPFilters allocates
+// their state for.
+#define MAX_BANDPASS_ORDER 4
+
+// The parameters a filter was designed with.
+struct DspFilterKey
+{
+    int order;
+    double sampleRate, frequency, bandwidth;
+
+    bool operator==(const DspFilterKey&) const;
+};
+
+uint qHash(const DspFilterKey&, uint = 0);
+
+// A cache of single channel Butterworth bandpass designs keyed by their
+// parameters, so the poles and zeros of a filter used every frame are only
+// calculated when its parameters change. The cache owns its filters.
+class DspFilterCache
+{
+public:
+    DspFilterCache();
+    ~DspFilterCache();
+    Dsp::Filter* bandpass(int, double, double, double);
+    void clear();
+
+private:
+    QHash<DspFilterKey, Dsp::Filter*> filters_;
+};
+
+#endif // DSPFILTERCACHE_H
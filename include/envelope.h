@@ -0,0 +1,20 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <QVector>
+
+// The minimum and maximum voltage of a waveform within each of a number of
+// equally sized columns spanning an interval of time. Used to draw dense
+// waveforms at screen resolution without losing narrow peaks. Columns
+// containing no samples have a minimum greater than their maximum.
+struct Envelope
+{
+    Envelope() : startTime(0.0), endTime(0.0) { }
+    bool isEmpty() const { return min.isEmpty(); }
+    int columns() const { return min.size(); }
+
+    QVector<float> min, max;
+    double startTime, endTime;
+};
+
+#endif // ENVELOPE_H
@@ -2,6 +2,7 @@
 #define EQUATIONDEFINITIONS_H
 
 #include <QString>
+#include <QStringList>
 
 // Definitions relevant to the math channel.
 
@@ -9,12 +10,18 @@ const double PI = 3.14159;
 
 const double E = 2.71828;
 
-typedef enum {OP, CONST} ExpType;
+typedef enum {OP, CONST, VAR} ExpType;
 
-typedef enum {PLUS, MINUS, TIMES, DIVIDE, EXP} Op;
+typedef enum {PLUS, MINUS, TIMES, DIVIDE, EXP, NEGATE,
+              ABS, SQRT, LOG, SIN, DIFF, INTEG, AVG, FFT} Op;
 
 typedef enum {OK, ERROR} Error;
 
-const QString validSymbols = "ABF+-*/^pe.()";
+const QString validSymbols = "ABF+-*/^.(),";
+
+// Names of the constants and functions that can be used in an equation.
+const QStringList validNames = QStringList() << "pi" << "e" << "abs" << "sqrt"
+                                             << "log" << "sin" << "diff" << "integ"
+                                             << "avg" << "fft";
 
 #endif // EQUATIONDEFINITIONS_H
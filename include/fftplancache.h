@@ -0,0 +1,56 @@
+#ifndef FFTPLANCACHE_H
+#define FFTPLANCACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QThreadStorage>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+
+#include <fftw3.h>
+
+// Number of plans each thread keeps before discarding the least recently
+// used.
+#define MAX_CACHED_PLANS 8
+
+// Largest transform planned with FFTW_MEASURE, larger transforms take too
+// long to measure and are planned with FFTW_ESTIMATE.
+#define MAX_MEASURED_SIZE 65536
+
+// A real to complex FFTW plan with its own aligned input and output
+// buffers.
+struct FftPlan
+{
+    int size;
+    double* input;
+    fftw_complex* spectrum;
+    fftw_plan plan;
+};
+
+// A per-thread cache of FFTW plans keyed by transform size, so that
+// transforms repeated every frame are planned and allocated only once.
+class FftPlanCache
+{
+public:
+    FftPlanCache();
+    ~FftPlanCache();
+    static FftPlanCache* local();
+    const FftPlan* plan(int);
+
+    // Global FFTW configuration.
+    static QMutex* plannerLock();
+    static void loadWisdom();
+    static void saveWisdom();
+
+private:
+    FftPlan* create(int);
+    void destroy(FftPlan*);
+    static QString wisdomPath();
+    QHash<int, FftPlan*> plans_;
+    QList<int> recent_;
+};
+
+#endif // FFTPLANCACHE_H
@@ -0,0 +1,56 @@
+#ifndef FIRFILTER_H
+#define FIRFILTER_H
+
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QElapsedTimer>
+
+#include <fftw3.h>
+
+#include <simd.h>
+#include <parallel.h>
+#include <fftplancache.h>
+
+// Tap count above which filtering is done by FFT convolution if the
+// crossover has not been measured.
+#define DEFAULT_FIR_CROSSOVER 64
+
+// A finite impulse response filter. Taps are held in an aligned contiguous
+// array, short filters are applied by direct convolution with a vectorised
+// dot product and long filters by overlap-save FFT convolution.
+class FirFilter
+{
+public:
+    FirFilter();
+    ~FirFilter();
+    void setTaps(const QList<double>&);
+    QList<double> taps() const;
+    int length() const;
+    void process(const float*, float*, int);
+
+    // Functions to choose between direct and FFT convolution.
+    static void measureCrossover();
+    static int crossover();
+
+private:
+    void processDirect(float*, int);
+    void convolve(float*, int, int) const;
+    void processFft(float*, int);
+    void preparePlans(int);
+    void releasePlans();
+    QList<double> tapList_;
+    double* taps_;
+    int length_;
+    QVector<double> padded_;
+
+    // FFT convolution buffers.
+    int fftSize_;
+    double* block_;
+    fftw_complex *spectrum_, *response_;
+    fftw_plan forward_, inverse_;
+
+    static int crossover_;
+};
+
+#endif // FIRFILTER_H
@@ -0,0 +1,39 @@
+#ifndef FREQUENCYMETER_H
+#define FREQUENCYMETER_H
+
+#include <QVector>
+#include <QtMath>
+
+#include <fftw3.h>
+
+#include <waveform.h>
+#include <fftplancache.h>
+#include <pulsestats.h>
+
+// Largest difference, in FFT bins, between the zero crossing and spectral
+// estimates for the zero crossing estimate to be trusted.
+#define CROSSING_TOLERANCE 2.0
+
+// The result of a frequency measurement. The period is in seconds, and the
+// duty cycle is a fraction of the period or negative if it is not known.
+struct FrequencyMeasurement
+{
+    double frequency, period, dutyCycle;
+};
+
+// Measures the fundamental frequency of a waveform. The peak of its windowed
+// spectrum is refined between bins by Gaussian interpolation and checked
+// against the frequency of its pulses, which also gives the duty cycle and
+// is more precise when the waveform holds several whole periods.
+class FrequencyMeter
+{
+public:
+    FrequencyMeter();
+    FrequencyMeasurement measure(const Waveform&, const PulseStats&);
+
+private:
+    double spectralPeak(const Waveform&, double*);
+    QVector<double> window_;
+};
+
+#endif // FREQUENCYMETER_H
@@ -0,0 +1,34 @@
+#ifndef INTERPOLATOR_H
+#define INTERPOLATOR_H
+
+#include <QVector>
+#include <QtMath>
+
+#include <simd.h>
+#include <parallel.h>
+
+// Number of input samples each output sample is interpolated from.
+#define INTERPOLATOR_TAPS_PER_PHASE 32
+
+// A polyphase interpolator raising the sample rate by an integer ratio. The
+// lowpass filter is a Blackman windowed sinc cut off at the Nyquist
+// frequency of the input, split into one phase per output sample between
+// two input samples, so only the input samples are multiplied and never the
+// zeros stuffed between them. The filter is centred on its output, so input
+// samples pass through unchanged and the output is not delayed.
+class Interpolator
+{
+public:
+    Interpolator();
+    void setRatio(int);
+    int ratio() const;
+    void process(const float*, int, double*);
+
+private:
+    void design();
+    int ratio_;
+    QVector<double> phases_;
+    QVector<double> padded_;
+};
+
+#endif // INTERPOLATOR_H
@@ -5,6 +5,7 @@
 #include <QLabel>
 #include <QRadioButton>
 #include <QSpinBox>
+#include <QCheckBox>
 #include <QComboBox>
 #include <QButtonGroup>
 #include <QActionGroup>
@@ -56,11 +57,16 @@ private:
     void closeEvent(QCloseEvent*);
     void loadFilter(QString);
     void updateFunctionGenText();
+    QList<QLabel*> measurementLabels(Channel) const;
     Plot *plot_;
     CommunicationHandler *comHandler_;
     QLabel *hostStatus_, *hostStatusIcon_, *deviceStatus_;
     QComboBox* bitModeSelect_;
     QSpinBox* noSamplesSelect_;
+    QCheckBox* spectrumSelect_;
+    QComboBox* spectrumWindowSelect_;
+    QSpinBox* spectrumAveragesSelect_;
+    QComboBox* bandpassRateSelect_;
     State* state_;
     QLabel *filterInfo_, *equationInfo_, *functionGenInfo_, *sampleRateLabel_;
     QMessageBox* voltageError_;
@@ -100,8 +106,7 @@ private slots:
     void functionVoltageChanged(int);
     void functionOffsetChanged(quint16);
     void functionFreqChanged(quint16);
-    void newMeasurements(int, double, double, double, double, double);
-    void newFrequency(int, double);
+    void newMeasurements(int, Measurements);
     void channelHidden(int);
     void about();
 
@@ -0,0 +1,25 @@
+#ifndef MEASUREMENTS_H
+#define MEASUREMENTS_H
+
+#include <QMetaType>
+
+// All automatic measurements of a frame of a channel, emitted together once
+// per frame. Voltages are in volts, times in seconds and overshoots in
+// percent. A negative time or duty cycle could not be measured.
+struct Measurements
+{
+    // Voltage statistics.
+    double max, min, peakToPeak, mean, stdDev, rms;
+    int clippedLow, clippedHigh;
+
+    // Frequency and timing.
+    double frequency, period, dutyCycle;
+    double riseTime, fallTime, positiveWidth, negativeWidth;
+
+    // Pulse levels.
+    double overshoot, undershoot, cycleRms;
+};
+
+Q_DECLARE_METATYPE(Measurements)
+
+#endif // MEASUREMENTS_H
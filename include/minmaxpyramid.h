@@ -0,0 +1,42 @@
+#ifndef MINMAXPYRAMID_H
+#define MINMAXPYRAMID_H
+
+#include <QVector>
+
+#include <qwt_scale_map.h>
+
+#include <waveform.h>
+#include <envelope.h>
+
+// The first level of the pyramid stored, level k holds the minimum and
+// maximum of each block of 2^k samples.
+#define PYRAMID_BASE_LEVEL 3
+
+// A multi-resolution min/max reduction of a waveform. Each level halves the
+// resolution of the one below it, so the envelope of any interval of the
+// waveform can be found in logarithmic time and a curve can be drawn at any
+// horizontal zoom in time proportional to the width of the canvas.
+class MinMaxPyramid
+{
+public:
+    MinMaxPyramid();
+
+    // Functions to build the pyramid.
+    void build(const Waveform&);
+    void clear();
+
+    // Functions to query the pyramid.
+    bool isEmpty() const;
+    int levels() const;
+    double samplesPerPixel(const QwtScaleMap&) const;
+    int levelFor(const QwtScaleMap&) const;
+    Envelope envelope(const QwtScaleMap&) const;
+
+private:
+    void reduceLevels();
+    void rangeMinMax(int, int, float*, float*) const;
+    Waveform base_;
+    QVector<QVector<float> > min_, max_;
+};
+
+#endif // MINMAXPYRAMID_H
@@ -0,0 +1,16 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+// Smallest number of iterations worth giving to another thread.
+#define PARALLEL_GRAIN 4096
+
+// Runs body over the range [0, count) split into contiguous chunks on the
+// shared thread pool, and returns once every chunk is done. Each chunk is
+// given its begin and end, and must only write outputs within it. The
+// calling thread runs chunks itself, so this may be called from a task
+// already on the pool.
+void parallelFor(int, const std::function<void(int, int)>&, int = PARALLEL_GRAIN);
+
+#endif // PARALLEL_H
@@ -7,11 +7,23 @@
 #include <QStack>
 #include <QDebug>
 #include <QVector>
-#include <QPointF>
 #include <QtMath>
 
 #include <equationdefinitions.h>
 #include <statedefinitions.h>
+#include <waveform.h>
+#include <bytecode.h>
+
+// A node of a parsed expression. Operators refer to their operands by their
+// index in the expression, which always precedes their own.
+struct ExpNode
+{
+    ExpType type;
+    Op op;
+    Channel channel;
+    double value;
+    int left, right;
+};
 
 // Class used for parsing and solving an equation for the given plots.
 class Parser
@@ -22,30 +34,36 @@ public:
     bool requiresA();
     bool requiresB();
     bool requiresF();
-    Error parse(QVector<QPointF>, QVector<QPointF>, QVector<QPointF>,
-                quint16, double, QVector<QPointF>*);
-    QVector<QPointF> plotData();
+    Error parse(const Waveform&, const Waveform&, const Waveform&,
+                quint16, double, Waveform*);
+    Waveform plotData();
     QString error();
 
 private:
-    // Parsing functions.
-    Error parse(double);
-    double parseExp();
-    double parseTerm();
-    double parseBase();
-    double parseUnary();
-    double parseFactor();
-
-    // Functions to provide the correct voltage for a given time.
-    bool withinBounds(Channel, double);
-    double approxVoltage(Channel, int, double);
-    QString error_;
+    // Parsing functions, each returns the index of the node it parsed.
+    Error compile();
+    int optimise(int, QVector<ExpNode>&, QVector<int>&);
+    int parseExp();
+    int parseTerm();
+    int parseBase();
+    int parseUnary();
+    int parseFactor();
+    int parseFunction();
+    int addNode(ExpType, Op, int, int, double = 0.0, Channel = M);
+
+    // Resamples a plot onto the time grid of the result.
+    void align(const Waveform&, double, double, int, QVector<float>&, bool);
+
+    QString error_, expression_;
+    Error status_;
     QStringList tokens_;
     int currentToken_;
-    QVector<QPointF>* resultPlot_;
-    QVector<QPointF> plotA_, plotB_, plotF_;
+    QVector<ExpNode> nodes_;
+    Bytecode bytecode_;
+    Waveform* resultPlot_;
+    Waveform plotA_, plotB_, plotF_;
+    QVector<float> alignedA_, alignedB_, alignedF_;
     bool requiresA_, requiresB_, requiresF_;
-    double currentAVal_, currentBVal_, currentFVal_;
 };
 
 #endif // PARSER_H
@@ -9,7 +9,6 @@
 #include <QTimer>
 #include <QLabel>
 #include <QHBoxLayout>
-#include <QThread>
 
 #include <qwt_plot.h>
 #include <qwt_plot_canvas.h>
@@ -22,6 +21,7 @@
 #include <qwt_symbol.h>
 
 #include <channelcurve.h>
+#include <waveformdata.h>
 #include <state.h>
 #include <voltagepicker.h>
 
@@ -40,6 +40,7 @@ public:
     // Pass in widgets to update.
     void setLegend(QFrame*);
     void setMarkerPlot(QwtPlot*);
+    void setSpectrumPlot(QwtPlot*);
     void setEquationLabel(QLabel*);
     void calculateFilter();
     void exit();
@@ -48,6 +49,13 @@ private:
     void styleCanvas();
     void scaleTriggerPlot(double);
     void selectClosePoint();
+    StateSnapshot snapshot() const;
+    ChannelCurve* curve(Channel) const;
+    QList<Channel> inputs(Channel) const;
+    bool active(Channel) const;
+    void request(Channel);
+    void process(Channel, StateSnapshot);
+    void updateDerived();
     State* state_;
     ChannelCurve *channelA_, *channelB_, *channelF_, *channelM_;
     QwtPlotMarker *triggerThreshold_, *pickedVoltage_;
@@ -57,7 +65,16 @@ private:
     QLabel* equationLabel_;
     VoltagePicker* picker_;
     QwtPlot* freqPlot_;
-    QThread *aThread_, *bThread_, *fThread_, *mThread_;
+    QVector<QwtPlotCurve*> spectra_;
+
+    // Frame generations of each channel, the latest requested and the latest
+    // plotted, and the generation of each input a derived channel was last
+    // requested with. A channel is busy while its frame is processed, and
+    // holds the latest frame requested meanwhile as pending.
+    QVector<quint64> requested_, plotted_;
+    QVector<QVector<quint64> > inputsUsed_;
+    QVector<bool> busy_, invalidated_;
+    QVector<StateSnapshot> pending_;
 
 
 public slots:
@@ -70,27 +87,26 @@ public slots:
     double changeTrigger();
     void solveEquation(QString);
     void plotAcquisition(int);
-    void plotReady(int, QVector<QPointF>);
+    void plotReady(int, Waveform, quint64);
+    void spectrumReady(int, Waveform);
+    void setSpectrumEnabled(bool);
+    void setSpectrumWindow(int);
+    void setSpectrumAverages(int);
+    void setBandpassRate(int);
 
 private slots:
     // Slots connected to local signals.
     void hideTrigger();
     void catchError(QString);
+    void finished(int, quint64);
     void pointSelected(int, int);
     void pointDeselected();
 
 signals:
     // Signals emitted to make changes in MainWindow.
     void error(QString);
-    void newMeasurements(int, double, double, double, double, double);
-    void newFrequency(int, double);
+    void newMeasurements(int, Measurements);
     void channelHidden(int);
-
-    // Functions called to plot a new curve using a copy of the current state.
-    void processA(State);
-    void processB(State);
-    void processF(State);
-    void processM(State);
 };
 
 #endif // PLOT_H
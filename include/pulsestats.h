@@ -0,0 +1,32 @@
+#ifndef PULSESTATS_H
+#define PULSESTATS_H
+
+#include <QtGlobal>
+#include <QtMath>
+
+// Hysteresis around the midpoint as a fraction of the peak to peak voltage,
+// crossings smaller than this are treated as noise.
+#define PULSE_HYSTERESIS 0.1
+
+// Number of bins of the histogram used to find the top and base levels.
+#define PULSE_HISTOGRAM_BINS 64
+
+// Timing and level measurements of the pulses in a frame. Times are in
+// seconds, voltages in volts and overshoots in percent of the pulse
+// amplitude. A negative time or duty cycle could not be measured, and the
+// frequency is 0 if the frame holds less than one whole period.
+struct PulseStats
+{
+    int periods;
+    double frequency, dutyCycle;
+    double riseTime, fallTime;
+    double positiveWidth, negativeWidth;
+    double top, base, overshoot, undershoot;
+    double cycleRms;
+};
+
+// Measures the pulses of count samples taken timeStep milliseconds apart, in
+// a single pass, given the minimum and maximum of the samples.
+PulseStats measurePulses(const float*, int, double, float, float);
+
+#endif // PULSESTATS_H
@@ -0,0 +1,25 @@
+#ifndef SAMPLESTATS_H
+#define SAMPLESTATS_H
+
+#include <QtGlobal>
+#include <QtMath>
+
+#include <simd.h>
+
+// Number of samples reduced by the vectorised kernels before their partial
+// results are merged into the running statistics.
+#define STATS_BLOCK_SIZE 1024
+
+// Statistics of a block of samples. The variance is that of the population,
+// samples at or beyond the clipping limits are counted as clipped.
+struct SampleStats
+{
+    int count, clippedLow, clippedHigh;
+    double min, max, mean, variance, rms;
+};
+
+// Returns the statistics of count samples in a single pass. Samples less
+// than or equal to low, or greater than or equal to high, are clipped.
+SampleStats measureSamples(const float*, int, float, float);
+
+#endif // SAMPLESTATS_H
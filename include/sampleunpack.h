@@ -0,0 +1,17 @@
+#ifndef SAMPLEUNPACK_H
+#define SAMPLEUNPACK_H
+
+#include <QtGlobal>
+
+#include <simd.h>
+
+// Functions to unpack the raw sample payload of an ACQUISITION message into
+// a contiguous array of sample values.
+
+// Unpacks count big endian 12 bit samples, each stored in 2 bytes.
+void unpackTwelveBit(const uchar*, quint16*, int);
+
+// Unpacks count 8 bit samples, each stored in 1 byte.
+void unpackEightBit(const uchar*, quint16*, int);
+
+#endif // SAMPLEUNPACK_H
@@ -0,0 +1,29 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <QtGlobal>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Definitions shared by the vectorised processing kernels. SSE2 kernels are
+// selected at compile time, AVX2 kernels are compiled with a function level
+// target attribute and selected at run time when the CPU supports them.
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SIMD_AVX2_DISPATCH
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+// Returns true if AVX2 and FMA kernels can be used on this machine.
+bool cpuHasAvx2();
+
+// Returns the dot product of two arrays of count values.
+double dotProduct(const double*, const double*, int);
+
+// Multiplies count values of the first array by those of the second.
+void multiplyInPlace(double*, const double*, int);
+
+#endif // SIMD_H
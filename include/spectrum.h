@@ -0,0 +1,34 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <QVector>
+#include <QtMath>
+
+#include <fftw3.h>
+
+#include <statedefinitions.h>
+#include <waveform.h>
+#include <fftplancache.h>
+
+// Lowest power reported, in dB, so that empty bins stay on the plot.
+#define SPECTRUM_FLOOR_DB -200.0
+
+// Calculates the windowed magnitude spectrum of a waveform in dBV, optionally
+// averaged over successive frames. The window, the transform plan and its
+// buffers are reused for as long as the frame length stays the same.
+class Spectrum
+{
+public:
+    Spectrum();
+    Waveform calculate(const Waveform&, SpectrumWindow, int);
+    void reset();
+
+private:
+    void prepareWindow(SpectrumWindow, int);
+    QVector<double> window_, power_;
+    SpectrumWindow windowType_;
+    double windowSum_, binWidth_;
+    int frames_;
+};
+
+#endif // SPECTRUM_H
@@ -5,17 +5,42 @@
 #include <QPointF>
 #include <QtMath>
 #include <QMetaType>
+#include <QSharedPointer>
+
+#include <cstring>
 
 #include <statedefinitions.h>
+#include <waveform.h>
+#include <biquadcascade.h>
+
+// A read-only view of a contiguous block of values owned by another
+// container. The view is invalidated when the owner is modified.
+template <typename T>
+class SampleSpan
+{
+public:
+    SampleSpan(const T* data = NULL, int size = 0) : data_(data), size_(size) { }
+    const T* data() const { return data_; }
+    int size() const { return size_; }
+    bool isEmpty() const { return size_ == 0; }
+    const T& operator[](int i) const { return data_[i]; }
+    const T* begin() const { return data_; }
+    const T* end() const { return data_ + size_; }
+
+private:
+    const T* data_;
+    int size_;
+};
 
 //A class containing all current state information to share across
 //all Digiscope classes that affect or are affected by the state.
 //Contains getter and setter methods to access all variables.
+//All containers are implicitly shared, so copying a State only
+//references its data until one of the copies is modified.
 class State
 {
 public:
     State();
-    State(const State &state);
     ~State();
     QVector<int> functionFreqs_;
 
@@ -50,8 +75,8 @@ public:
     void setTriggerType(TriggerType);
 
     // Currently plotted data
-    QVector<QPointF> getPlotPoints(Channel) const;
-    void setPlotPoints(Channel, QVector<QPointF>);
+    Waveform getPlotPoints(Channel) const;
+    void setPlotPoints(Channel, const Waveform&);
     void clearPlot(Channel);
 
     // Function generator
@@ -67,8 +92,8 @@ public:
     void setFunctionFreq(quint16);
 
     // Acquisition data
-    QList<quint16> getAcquisition(Channel) const;
-    void setAcquisition(Channel, QList<quint16>);
+    SampleSpan<quint16> getAcquisition(Channel) const;
+    void setAcquisition(Channel, const quint16*, int);
     void clearAcquisition(Channel);
     bool triggerForced() const;
     void setTriggerForced(bool);
@@ -80,6 +105,8 @@ public:
     void setATaps(QList<double>);
     QList<double> getBTaps() const;
     void setBTaps(QList<double>);
+    BiquadCascade getSections() const;
+    void setSections(const BiquadCascade&);
     Channel getFilterChannel() const;
     void setFilterChannel(Channel);
     FilterType getFilterType() const;
@@ -91,6 +118,18 @@ public:
     QString getEquation() const;
     void setEquation(QString);
 
+    // Band-pass output
+    int getBandpassRate() const;
+    void setBandpassRate(int);
+
+    // Spectrum analyser
+    bool spectrumEnabled() const;
+    void setSpectrumEnabled(bool);
+    SpectrumWindow getSpectrumWindow() const;
+    void setSpectrumWindow(SpectrumWindow);
+    int getSpectrumAverages() const;
+    void setSpectrumAverages(int);
+
 private:
     quint16 noSamples_, aOffset_, bOffset_, triggerThreshold_;
     TriggerState triggerState_;
@@ -101,19 +140,29 @@ private:
     Channel triggerChannel_, filterChannel_;
     TriggerMode triggerMode_;
     TriggerType triggerType_;
-    QVector<QPointF> aData_, bData_, fData_, mData_;
+    Waveform aData_, bData_, fData_, mData_;
     FunctionGenState functionState_;
     FunctionWaveType functionWave_;
     quint16  functionOffset_, functionFreq_;
-    QList<quint16> aAcquisition_, bAcquisition_;
+    QVector<quint16> aAcquisition_, bAcquisition_;
     QList<double> aTaps_, bTaps_;
+    BiquadCascade sections_;
     QString equation_;
     FilterType filterType_;
     bool filterEnabled_;
     bool triggerForced_;
     int triggerIndex_;
+    bool spectrumEnabled_;
+    SpectrumWindow spectrumWindow_;
+    int spectrumAverages_;
+    int bandpassRate_;
 };
 
+// An immutable copy of the state, published once per frame and shared by
+// pointer between the channel processing threads.
+typedef QSharedPointer<const State> StateSnapshot;
+
 Q_DECLARE_METATYPE(State)
+Q_DECLARE_METATYPE(StateSnapshot)
 
 #endif // STATE_H
@@ -25,6 +25,20 @@ enum FilterType {IIR, FIR};
 
 enum FilteringMode {LOWPASS, BANDPASS};
 
+// Sample rates the band-pass channel can be decimated to after
+// demodulation, in Hz. The lowest keeps the filtered band below half the
+// sample rate.
+static const QVector<double> bandpassRates = {2000000, 4000000, 10000000, 20000000};
+
+// Index of the band-pass rate selected at startup.
+#define DEFAULT_BANDPASS_RATE 1
+
+// Most band-pass output points for each sample acquired. Slower timebases
+// are reduced further to the peaks of the band.
+#define BANDPASS_POINTS_PER_SAMPLE 4
+
+enum SpectrumWindow {HANN, BLACKMAN, FLAT_TOP};
+
 enum TriggerState {ARMED, TRIGGERED, STOPPED};
 
 enum TriggerMode {AUTO, NORMAL, SINGLE};
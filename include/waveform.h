@@ -0,0 +1,40 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <QVector>
+#include <QMetaType>
+
+// A uniformly sampled channel waveform. Only the voltage of each sample is
+// stored, the time of sample i is startTime() + i * timeStep(). The values
+// are implicitly shared, so copying a Waveform does not copy its samples.
+class Waveform
+{
+public:
+    Waveform(double startTime = 0.0, double timeStep = 0.0, int size = 0);
+
+    // Time axis.
+    double startTime() const { return t0_; }
+    double timeStep() const { return dt_; }
+    double endTime() const;
+    double time(int i) const { return t0_ + i * dt_; }
+    void setTiming(double, double);
+
+    // Sample values.
+    int size() const { return y_.size(); }
+    bool isEmpty() const { return y_.isEmpty(); }
+    float value(int i) const { return y_.at(i); }
+    const float* constData() const { return y_.constData(); }
+    float* data() { return y_.data(); }
+    void append(float value) { y_.append(value); }
+    void resize(int);
+    void reserve(int);
+    void clear();
+
+private:
+    QVector<float> y_;
+    double t0_, dt_;
+};
+
+Q_DECLARE_METATYPE(Waveform)
+
+#endif // WAVEFORM_H
@@ -0,0 +1,26 @@
+#ifndef WAVEFORMDATA_H
+#define WAVEFORMDATA_H
+
+#include <QPointF>
+#include <QRectF>
+
+#include <qwt_series_data.h>
+
+#include <waveform.h>
+
+// Adapter presenting a Waveform to Qwt as a series of points. The x value of
+// each point is calculated from the waveform's timing when it is requested.
+class WaveformData : public QwtSeriesData<QPointF>
+{
+public:
+    WaveformData(const Waveform& waveform = Waveform());
+    const Waveform& waveform() const;
+    virtual size_t size() const;
+    virtual QPointF sample(size_t) const;
+    virtual QRectF boundingRect() const;
+
+private:
+    Waveform waveform_;
+};
+
+#endif // WAVEFORMDATA_H
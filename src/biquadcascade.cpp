@@ -0,0 +1,289 @@
+#include "biquadcascade.h"
+
+#include <qmath.h>
+
+typedef std::complex<double> Complex;
+
+// Tolerance used to decide whether a root is real.
+static const double REAL_TOLERANCE = 1e-9;
+
+BiquadCascade::BiquadCascade()
+{
+
+}
+
+// Factors the filter with numerator taps b and denominator taps a, in
+// increasing powers of z^-1, into second order sections. Returns false if
+// the taps do not describe a causal filter or their roots can not be found.
+bool BiquadCascade::design(const QList<double>& b, const QList<double>& a) {
+    sections_.clear();
+
+    if (a.isEmpty() || b.isEmpty() || a.first() == 0.0)
+        return false;
+
+    // Numerator taps before the first non-zero tap are a pure delay.
+    int delay = 0;
+    while (delay < b.size() && b.at(delay) == 0.0) delay++;
+
+    if (delay == b.size())
+        return false;
+
+    int lastB = b.size() - 1;
+    while (b.at(lastB) == 0.0) lastB--;
+
+    int lastA = a.size() - 1;
+    while (a.at(lastA) == 0.0) lastA--;
+
+    // Polynomials in z with the roots of the numerator and denominator.
+    QVector<double> numerator, denominator;
+    for (int i = delay; i <= lastB; i++) numerator.append(b.at(i));
+    for (int i = 0; i <= lastA; i++) denominator.append(a.at(i));
+
+    QVector<Complex> zeros, poles;
+    if (!findRoots(numerator, &zeros) || !findRoots(denominator, &poles))
+        return false;
+
+    int numSections = (qMax(zeros.size() + delay, poles.size()) + 1) / 2;
+    QVector<QVector<double> > zeroFactors = pairFactors(zeros, delay);
+    QVector<QVector<double> > poleFactors = pairFactors(poles, 0);
+
+    // Pad with unity factors so every section has a numerator and
+    // denominator.
+    QVector<double> unity;
+    unity << 1.0 << 0.0 << 0.0;
+    while (zeroFactors.size() < numSections) zeroFactors.append(unity);
+    while (poleFactors.size() < numSections) poleFactors.append(unity);
+
+    // Match each denominator, starting with the poles nearest the unit
+    // circle, with the numerator whose zeros are closest to its poles.
+    for (int i = 0; i < numSections; i++) {
+        const QVector<double>& pole = poleFactors.at(i);
+        int best = 0;
+        double bestDistance = 0.0;
+
+        for (int j = 0; j < zeroFactors.size(); j++) {
+            const QVector<double>& zero = zeroFactors.at(j);
+            double distance = qAbs(zero.at(1) - pole.at(1)) + qAbs(zero.at(2) - pole.at(2));
+
+            if (j == 0 || distance < bestDistance) {
+                best = j;
+                bestDistance = distance;
+            }
+        }
+
+        const QVector<double>& zero = zeroFactors.at(best);
+        Biquad section;
+        section.b0 = zero.at(0);
+        section.b1 = zero.at(1);
+        section.b2 = zero.at(2);
+        section.a1 = pole.at(1);
+        section.a2 = pole.at(2);
+        sections_.append(section);
+        zeroFactors.remove(best);
+    }
+
+    // Apply the overall gain to the first section.
+    double gain = b.at(delay) / a.first();
+    sections_[0].b0 *= gain;
+    sections_[0].b1 *= gain;
+    sections_[0].b2 *= gain;
+
+    return true;
+}
+
+// Returns true if the cascade has no sections.
+bool BiquadCascade::isEmpty() const {
+    return sections_.isEmpty();
+}
+
+// Returns the number of second order sections.
+int BiquadCascade::sections() const {
+    return sections_.size();
+}
+
+// Returns the coefficients of each section.
+const QVector<Biquad>& BiquadCascade::coefficients() const {
+    return sections_;
+}
+
+// Filters count samples of input into output, starting from rest. Each
+// section is run over the whole frame in transposed direct form II before
+// the next, keeping its state in registers.
+void BiquadCascade::process(const float* input, float* output, int count) const {
+    QVector<double> buffer(count);
+    double* x = buffer.data();
+
+    for (int i = 0; i < count; i++) {
+        x[i] = input[i];
+    }
+
+    for (int s = 0; s < sections_.size(); s++) {
+        const Biquad& c = sections_.at(s);
+        double z1 = 0.0, z2 = 0.0;
+
+        for (int i = 0; i < count; i++) {
+            double in = x[i];
+            double out = c.b0 * in + z1;
+            z1 = c.b1 * in - c.a1 * out + z2;
+            z2 = c.b2 * in - c.a2 * out;
+            x[i] = out;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        output[i] = (float)x[i];
+    }
+}
+
+// Finds the roots of the polynomial with the given coefficients, in
+// decreasing powers, using the Aberth-Ehrlich method. Returns false if the
+// roots do not converge.
+bool BiquadCascade::findRoots(const QVector<double>& coefficients,
+                              QVector<Complex>* roots) {
+    int degree = coefficients.size() - 1;
+    roots->clear();
+
+    if (degree <= 0)
+        return true;
+
+    // Monic polynomial and its derivative.
+    QVector<double> p(degree + 1), dp(degree);
+    for (int i = 0; i <= degree; i++) {
+        p[i] = coefficients.at(i) / coefficients.at(0);
+    }
+    for (int i = 0; i < degree; i++) {
+        dp[i] = p.at(i) * (degree - i);
+    }
+
+    // Start on a circle bounding the roots, offset from the real axis so
+    // conjugate roots separate.
+    double radius = 0.0;
+    for (int i = 1; i <= degree; i++) {
+        radius = qMax(radius, qPow(qAbs(p.at(i)), 1.0 / i));
+    }
+    radius = qMax(radius, 1e-3);
+
+    for (int i = 0; i < degree; i++) {
+        double angle = 2.0 * M_PI * i / degree + 0.4;
+        roots->append(std::polar(radius, angle));
+    }
+
+    for (int iteration = 0; iteration < 500; iteration++) {
+        double largestStep = 0.0;
+
+        for (int i = 0; i < degree; i++) {
+            Complex z = roots->at(i);
+            Complex value = p.at(0), slope = dp.at(0);
+
+            for (int k = 1; k <= degree; k++) value = value * z + p.at(k);
+            for (int k = 1; k < degree; k++) slope = slope * z + dp.at(k);
+
+            if (value == 0.0) continue;
+
+            Complex ratio = value / slope;
+            Complex repulsion = 0.0;
+
+            for (int j = 0; j < degree; j++) {
+                if (j != i) repulsion += 1.0 / (z - roots->at(j));
+            }
+
+            Complex step = ratio / (1.0 - ratio * repulsion);
+            (*roots)[i] = z - step;
+            largestStep = qMax(largestStep, std::abs(step) / qMax(1.0, std::abs(z)));
+        }
+
+        if (largestStep < 1e-14)
+            return true;
+    }
+
+    // Accept roots that have not fully converged as long as they are close.
+    for (int i = 0; i < degree; i++) {
+        Complex z = roots->at(i);
+        Complex value = p.at(0);
+        for (int k = 1; k <= degree; k++) value = value * z + p.at(k);
+
+        if (std::abs(value) > 1e-6)
+            return false;
+    }
+
+    return true;
+}
+
+// Combines roots into real second order factors [1, c1, c2] of
+// (1 - r1 z^-1)(1 - r2 z^-1), pairing complex roots with their conjugates
+// and real roots with each other. delay factors of z^-1 are added for
+// numerators with leading zero taps. Factors are ordered with roots nearest
+// the unit circle first.
+QVector<QVector<double> > BiquadCascade::pairFactors(QVector<Complex> roots, int delay) {
+    QVector<QVector<double> > factors;
+    QVector<double> reals;
+
+    // Order by decreasing magnitude so the most resonant sections come first.
+    for (int i = 1; i < roots.size(); i++) {
+        for (int j = i; j > 0 && std::abs(roots.at(j)) > std::abs(roots.at(j - 1)); j--) {
+            Complex swap = roots.at(j);
+            roots[j] = roots.at(j - 1);
+            roots[j - 1] = swap;
+        }
+    }
+
+    while (!roots.isEmpty()) {
+        Complex root = roots.takeFirst();
+
+        if (qAbs(root.imag()) <= REAL_TOLERANCE * qMax(1.0, std::abs(root))) {
+            reals.append(root.real());
+            continue;
+        }
+
+        // Find the conjugate of this root.
+        int partner = -1;
+        double partnerDistance = 0.0;
+        for (int j = 0; j < roots.size(); j++) {
+            double distance = std::abs(roots.at(j) - std::conj(root));
+            if (partner < 0 || distance < partnerDistance) {
+                partner = j;
+                partnerDistance = distance;
+            }
+        }
+
+        if (partner >= 0)
+            roots.remove(partner);
+
+        QVector<double> factor;
+        factor << 1.0 << -2.0 * root.real() << std::norm(root);
+        factors.append(factor);
+    }
+
+    for (int i = 0; i + 1 < reals.size(); i += 2) {
+        QVector<double> factor;
+        factor << 1.0 << -(reals.at(i) + reals.at(i + 1)) << reals.at(i) * reals.at(i + 1);
+        factors.append(factor);
+    }
+
+    // A remaining real root is combined with a delay if there is one.
+    if (reals.size() % 2 == 1) {
+        QVector<double> factor;
+        if (delay > 0) {
+            factor << 0.0 << 1.0 << -reals.last();
+            delay--;
+        } else {
+            factor << 1.0 << -reals.last() << 0.0;
+        }
+        factors.append(factor);
+    }
+
+    while (delay >= 2) {
+        QVector<double> factor;
+        factor << 0.0 << 0.0 << 1.0;
+        factors.append(factor);
+        delay -= 2;
+    }
+
+    if (delay == 1) {
+        QVector<double> factor;
+        factor << 0.0 << 1.0 << 0.0;
+        factors.append(factor);
+    }
+
+    return factors;
+}
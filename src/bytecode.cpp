@@ -0,0 +1,533 @@
+#include "bytecode.h"
+
+typedef void (*BinaryKernel)(const float*, const float*, float*, int);
+typedef void (*UnaryKernel)(const float*, float*, int);
+
+// The block kernels used to run instructions on this machine.
+struct Kernels
+{
+    BinaryKernel add, sub, mul, div, pow;
+    UnaryKernel neg, abs, sqrt;
+};
+
+// State kept by a stateful instruction from one block to the next.
+struct OperatorState
+{
+    double previous, sum;
+    QVector<float> history;
+    int position, filled;
+};
+
+// Scalar kernels.
+static void addScalar(const float* a, const float* b, float* out, int count) {
+    for (int i = 0; i < count; i++) out[i] = a[i] + b[i];
+}
+
+static void subScalar(const float* a, const float* b, float* out, int count) {
+    for (int i = 0; i < count; i++) out[i] = a[i] - b[i];
+}
+
+static void mulScalar(const float* a, const float* b, float* out, int count) {
+    for (int i = 0; i < count; i++) out[i] = a[i] * b[i];
+}
+
+static void divScalar(const float* a, const float* b, float* out, int count) {
+    for (int i = 0; i < count; i++) out[i] = a[i] / b[i];
+}
+
+static void powScalar(const float* a, const float* b, float* out, int count) {
+    for (int i = 0; i < count; i++) out[i] = (float)qPow(a[i], b[i]);
+}
+
+static void negScalar(const float* a, float* out, int count) {
+    for (int i = 0; i < count; i++) out[i] = -a[i];
+}
+
+static void absScalar(const float* a, float* out, int count) {
+    for (int i = 0; i < count; i++) out[i] = qAbs(a[i]);
+}
+
+static void sqrtScalar(const float* a, float* out, int count) {
+    for (int i = 0; i < count; i++) out[i] = (float)qSqrt(a[i]);
+}
+
+static void logScalar(const float* a, float* out, int count) {
+    for (int i = 0; i < count; i++) out[i] = (float)qLn(a[i]);
+}
+
+static void sinScalar(const float* a, float* out, int count) {
+    for (int i = 0; i < count; i++) out[i] = (float)qSin(a[i]);
+}
+
+#ifdef __SSE2__
+// SSE2 kernels, 4 samples per iteration.
+static void addSse2(const float* a, const float* b, float* out, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    addScalar(a + i, b + i, out + i, count - i);
+}
+
+static void subSse2(const float* a, const float* b, float* out, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    subScalar(a + i, b + i, out + i, count - i);
+}
+
+static void mulSse2(const float* a, const float* b, float* out, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    mulScalar(a + i, b + i, out + i, count - i);
+}
+
+static void divSse2(const float* a, const float* b, float* out, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_div_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    divScalar(a + i, b + i, out + i, count - i);
+}
+
+static void negSse2(const float* a, float* out, int count) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_xor_ps(_mm_loadu_ps(a + i), sign));
+    negScalar(a + i, out + i, count - i);
+}
+
+static void absSse2(const float* a, float* out, int count) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_andnot_ps(sign, _mm_loadu_ps(a + i)));
+    absScalar(a + i, out + i, count - i);
+}
+
+static void sqrtSse2(const float* a, float* out, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(out + i, _mm_sqrt_ps(_mm_loadu_ps(a + i)));
+    sqrtScalar(a + i, out + i, count - i);
+}
+#endif
+
+#ifdef SIMD_AVX2_DISPATCH
+// AVX2 kernels, 8 samples per iteration.
+SIMD_TARGET_AVX2
+static void addAvx2(const float* a, const float* b, float* out, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    addScalar(a + i, b + i, out + i, count - i);
+}
+
+SIMD_TARGET_AVX2
+static void subAvx2(const float* a, const float* b, float* out, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    subScalar(a + i, b + i, out + i, count - i);
+}
+
+SIMD_TARGET_AVX2
+static void mulAvx2(const float* a, const float* b, float* out, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    mulScalar(a + i, b + i, out + i, count - i);
+}
+
+SIMD_TARGET_AVX2
+static void divAvx2(const float* a, const float* b, float* out, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    divScalar(a + i, b + i, out + i, count - i);
+}
+
+SIMD_TARGET_AVX2
+static void negAvx2(const float* a, float* out, int count) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_xor_ps(_mm256_loadu_ps(a + i), sign));
+    negScalar(a + i, out + i, count - i);
+}
+
+SIMD_TARGET_AVX2
+static void absAvx2(const float* a, float* out, int count) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_andnot_ps(sign, _mm256_loadu_ps(a + i)));
+    absScalar(a + i, out + i, count - i);
+}
+
+SIMD_TARGET_AVX2
+static void sqrtAvx2(const float* a, float* out, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_sqrt_ps(_mm256_loadu_ps(a + i)));
+    sqrtScalar(a + i, out + i, count - i);
+}
+
+// Natural logarithm of 8 positive values, using the Cephes single precision
+// polynomial on the mantissa.
+SIMD_TARGET_AVX2
+static inline __m256 logAvx2(__m256 x) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    x = _mm256_max_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x00800000)));
+
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23),
+                                                   _mm256_set1_epi32(126)));
+    x = _mm256_or_ps(_mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x807FFFFF))),
+                     _mm256_set1_ps(0.5f));
+
+    // Bring the mantissa into [sqrt(1/2), sqrt(2)).
+    __m256 small = _mm256_cmp_ps(x, _mm256_set1_ps(0.707106781186547524f), _CMP_LT_OQ);
+    e = _mm256_sub_ps(e, _mm256_and_ps(one, small));
+    x = _mm256_sub_ps(_mm256_add_ps(x, _mm256_and_ps(x, small)), one);
+
+    __m256 z = _mm256_mul_ps(x, x);
+    __m256 y = _mm256_set1_ps(7.0376836292E-2f);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(-1.1514610310E-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.1676998740E-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(-1.2420140846E-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.4249322787E-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(-1.6668057665E-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(2.0000714765E-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(-2.4999993993E-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(3.3333331174E-1f));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+
+    y = _mm256_fmadd_ps(e, _mm256_set1_ps(-2.12194440e-4f), y);
+    y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+    x = _mm256_add_ps(x, y);
+    return _mm256_fmadd_ps(e, _mm256_set1_ps(0.693359375f), x);
+}
+
+// Exponential of 8 values, using the Cephes single precision polynomial.
+SIMD_TARGET_AVX2
+static inline __m256 expAvx2(__m256 x) {
+    x = _mm256_min_ps(x, _mm256_set1_ps(88.3762626647949f));
+    x = _mm256_max_ps(x, _mm256_set1_ps(-88.3762626647949f));
+
+    __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    x = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+    x = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), x);
+
+    __m256 y = _mm256_set1_ps(1.9875691500E-4f);
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.3981999507E-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(8.3334519073E-3f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(4.1665795894E-2f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(1.6666665459E-1f));
+    y = _mm256_fmadd_ps(y, x, _mm256_set1_ps(5.0000001201E-1f));
+    y = _mm256_fmadd_ps(y, _mm256_mul_ps(x, x), _mm256_add_ps(x, _mm256_set1_ps(1.0f)));
+
+    __m256i scale = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n),
+                                                       _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(y, _mm256_castsi256_ps(scale));
+}
+
+// Raises a to the power b as exp(b * log|a|). A negative base gives a
+// negative result for odd integer powers and NaN for fractional powers.
+SIMD_TARGET_AVX2
+static void powAvx2(const float* a, const float* b, float* out, int count) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(a + i);
+        __m256 y = _mm256_loadu_ps(b + i);
+        __m256 r = expAvx2(_mm256_mul_ps(y, logAvx2(_mm256_andnot_ps(sign, x))));
+
+        __m256 rounded = _mm256_round_ps(y, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 integer = _mm256_cmp_ps(rounded, y, _CMP_EQ_OQ);
+        __m256i oddBits = _mm256_slli_epi32(_mm256_cvtps_epi32(rounded), 31);
+        __m256 negative = _mm256_cmp_ps(x, zero, _CMP_LT_OQ);
+
+        r = _mm256_or_ps(r, _mm256_and_ps(_mm256_and_ps(negative, integer),
+                                          _mm256_castsi256_ps(oddBits)));
+        r = _mm256_blendv_ps(r, _mm256_set1_ps(NAN), _mm256_andnot_ps(integer, negative));
+
+        // Zero raised to a negative power is infinite.
+        __m256 pole = _mm256_and_ps(_mm256_cmp_ps(x, zero, _CMP_EQ_OQ),
+                                    _mm256_cmp_ps(y, zero, _CMP_LT_OQ));
+        r = _mm256_blendv_ps(r, _mm256_set1_ps(INFINITY), pole);
+
+        _mm256_storeu_ps(out + i, r);
+    }
+
+    powScalar(a + i, b + i, out + i, count - i);
+}
+#endif
+
+// Chooses the fastest kernels available on this machine.
+static Kernels selectKernels() {
+#ifdef SIMD_AVX2_DISPATCH
+    if (cpuHasAvx2()) {
+        Kernels avx2 = {addAvx2, subAvx2, mulAvx2, divAvx2, powAvx2,
+                         negAvx2, absAvx2, sqrtAvx2};
+        return avx2;
+    }
+#endif
+#ifdef __SSE2__
+    Kernels sse2 = {addSse2, subSse2, mulSse2, divSse2, powScalar,
+                     negSse2, absSse2, sqrtSse2};
+    return sse2;
+#else
+    Kernels scalar = {addScalar, subScalar, mulScalar, divScalar, powScalar,
+                       negScalar, absScalar, sqrtScalar};
+    return scalar;
+#endif
+}
+
+// Returns the kernels chosen for this machine. They are chosen on first use,
+// which is thread safe for a local static, as frames run on any pool thread.
+static const Kernels& kernels() {
+    static const Kernels selected = selectKernels();
+    return selected;
+}
+
+// Raises each value to a small integer power by repeated squaring, exactly
+// as repeated multiplication would.
+static void powInteger(const float* a, int exponent, float* out, float* scratch, int count) {
+    const Kernels& k = kernels();
+    int n = qAbs(exponent);
+
+    // out holds the result so far, scratch the base squared each step.
+    for (int i = 0; i < count; i++) out[i] = 1.0f;
+    memcpy(scratch, a, count * sizeof(float));
+
+    while (n > 0) {
+        if (n & 1) k.mul(out, scratch, out, count);
+        n >>= 1;
+        if (n > 0) k.mul(scratch, scratch, scratch, count);
+    }
+
+    if (exponent < 0) {
+        for (int i = 0; i < count; i++) out[i] = 1.0f / out[i];
+    }
+}
+
+// Derivative of the samples with respect to time, in units per second. The
+// first sample of the frame has no derivative and gives 0.
+static void differentiate(const float* in, float* out, int count,
+                          double timeStep, OperatorState& state) {
+    for (int i = 0; i < count; i++) {
+        out[i] = state.filled ? (float)((in[i] - state.previous) / timeStep) : 0.0f;
+        state.previous = in[i];
+        state.filled = 1;
+    }
+}
+
+// Running integral of the samples from the start of the frame, in unit
+// seconds, using the trapezoidal rule.
+static void integrate(const float* in, float* out, int count,
+                      double timeStep, OperatorState& state) {
+    for (int i = 0; i < count; i++) {
+        if (state.filled)
+            state.sum += 0.5 * (state.previous + in[i]) * timeStep;
+        out[i] = (float)state.sum;
+        state.previous = in[i];
+        state.filled = 1;
+    }
+}
+
+// Moving average of the samples over the length of the history. Samples at
+// the start of the frame are averaged over the samples before them.
+static void average(const float* in, float* out, int count, OperatorState& state) {
+    float* history = state.history.data();
+    int length = state.history.size();
+
+    for (int i = 0; i < count; i++) {
+        if (state.filled == length)
+            state.sum -= history[state.position];
+        else
+            state.filled++;
+
+        history[state.position] = in[i];
+        state.sum += in[i];
+        state.position = (state.position + 1) % length;
+        out[i] = (float)(state.sum / state.filled);
+    }
+}
+
+// Amplitude spectrum of the whole frame, from DC at the first sample to the
+// Nyquist frequency at the last. Each bin is held for two samples so the
+// spectrum spans the frame.
+static void transform(const float* in, float* out, int count) {
+    if (count < 2) {
+        for (int i = 0; i < count; i++) out[i] = 0.0f;
+        return;
+    }
+
+    const FftPlan* plan = FftPlanCache::local()->plan(count);
+    for (int i = 0; i < count; i++) plan->input[i] = in[i];
+    fftw_execute(plan->plan);
+
+    const fftw_complex* spectrum = plan->spectrum;
+    for (int i = 0; i < count; i++) {
+        int bin = i / 2;
+        double scale = (bin == 0) ? 1.0 / count : 2.0 / count;
+        out[i] = (float)(scale * qSqrt(spectrum[bin][0] * spectrum[bin][0]
+                                       + spectrum[bin][1] * spectrum[bin][1]));
+    }
+}
+
+Bytecode::Bytecode()
+{
+    registers_ = 0;
+    result_ = 0;
+    wholeFrame_ = false;
+}
+
+// Removes all instructions.
+void Bytecode::clear() {
+    code_.clear();
+    registers_ = 0;
+    result_ = 0;
+    wholeFrame_ = false;
+}
+
+// Appends an instruction to the end of the program.
+void Bytecode::append(const Instruction& instruction) {
+    code_.append(instruction);
+    registers_ = qMax(registers_, instruction.dest + 1);
+    if (instruction.code == CALL_FFT) wholeFrame_ = true;
+}
+
+// Sets the register holding the result once every instruction has run.
+void Bytecode::setResult(int reg) {
+    result_ = reg;
+}
+
+// Returns true if the program has no instructions.
+bool Bytecode::isEmpty() const {
+    return code_.isEmpty();
+}
+
+// Returns the number of instructions in the program.
+int Bytecode::size() const {
+    return code_.size();
+}
+
+// Returns the program as text, one instruction per line.
+QStringList Bytecode::listing() const {
+    static const char* names[] = {"load", "load", "load", "const", "add", "sub",
+                                  "mul", "div", "pow", "neg", "abs", "sqrt", "log",
+                                  "sin", "diff", "integ", "avg", "fft"};
+    QStringList lines;
+
+    for (int i = 0; i < code_.size(); i++) {
+        const Instruction& op = code_.at(i);
+        QString line = "r" + QString::number(op.dest) + " = " + names[op.code];
+
+        switch (op.code) {
+            case LOAD_A: line += " A"; break;
+            case LOAD_B: line += " B"; break;
+            case LOAD_F: line += " F"; break;
+            case LOAD_CONST: line += " " + QString::number(op.value); break;
+            case ADD: case SUB: case MUL: case DIV: case POW:
+                line += " r" + QString::number(op.left) + " r" + QString::number(op.right);
+                break;
+            case CALL_AVG:
+                line += " r" + QString::number(op.left) + " " + QString::number(op.value);
+                break;
+            default:
+                line += " r" + QString::number(op.left);
+                break;
+        }
+
+        lines.append(line);
+    }
+
+    lines.append("result r" + QString::number(result_));
+    return lines;
+}
+
+// Runs the program for count samples of the A, B and F inputs, storing the
+// result of each sample in output. Inputs that are not used may be NULL.
+// The time step is the time between samples in seconds.
+void Bytecode::run(const float* a, const float* b, const float* f,
+                   float* output, int count, double timeStep) const {
+    if (code_.isEmpty() || count <= 0) return;
+
+    const Kernels& k = kernels();
+    int block = wholeFrame_ ? count : BYTECODE_BLOCK;
+
+    // Each register has a block of storage, and points either to its storage
+    // or to the current block of an input.
+    QVector<float> storage((registers_ + 1) * block);
+    QVector<const float*> registers(registers_);
+    QVector<const Instruction*> constants(registers_, NULL);
+    QVector<OperatorState> states(code_.size());
+    float* scratch = storage.data() + registers_ * block;
+    const float** reg = registers.data();
+    const Instruction* code = code_.constData();
+    int length = code_.size();
+
+    for (int j = 0; j < length; j++) {
+        float* storageBlock = storage.data() + code[j].dest * block;
+        reg[code[j].dest] = storageBlock;
+
+        OperatorState& state = states[j];
+        state.previous = 0.0;
+        state.sum = 0.0;
+        state.position = 0;
+        state.filled = 0;
+
+        if (code[j].code == LOAD_CONST) {
+            constants[code[j].dest] = &code[j];
+            for (int i = 0; i < block; i++) storageBlock[i] = (float)code[j].value;
+        } else if (code[j].code == CALL_AVG) {
+            state.history.resize(qMax(1, qRound(code[j].value)));
+        }
+    }
+
+    for (int start = 0; start < count; start += block) {
+        int n = qMin(block, count - start);
+
+        for (int j = 0; j < length; j++) {
+            const Instruction& op = code[j];
+            float* dest = storage.data() + op.dest * block;
+
+            switch (op.code) {
+                case LOAD_A: reg[op.dest] = a + start; break;
+                case LOAD_B: reg[op.dest] = b + start; break;
+                case LOAD_F: reg[op.dest] = f + start; break;
+                case LOAD_CONST: break;
+                case ADD: k.add(reg[op.left], reg[op.right], dest, n); break;
+                case SUB: k.sub(reg[op.left], reg[op.right], dest, n); break;
+                case MUL: k.mul(reg[op.left], reg[op.right], dest, n); break;
+                case DIV: k.div(reg[op.left], reg[op.right], dest, n); break;
+                case NEG: k.neg(reg[op.left], dest, n); break;
+                case POW: {
+                    const Instruction* exponent = constants[op.right];
+                    if (exponent && exponent->value == qRound(exponent->value)
+                            && qAbs(exponent->value) <= MAX_INTEGER_POWER) {
+                        powInteger(reg[op.left], qRound(exponent->value), dest, scratch, n);
+                    } else {
+                        k.pow(reg[op.left], reg[op.right], dest, n);
+                    }
+                    break;
+                }
+                case CALL_ABS: k.abs(reg[op.left], dest, n); break;
+                case CALL_SQRT: k.sqrt(reg[op.left], dest, n); break;
+                case CALL_LOG: logScalar(reg[op.left], dest, n); break;
+                case CALL_SIN: sinScalar(reg[op.left], dest, n); break;
+                case CALL_DIFF: differentiate(reg[op.left], dest, n, timeStep, states[j]); break;
+                case CALL_INTEG: integrate(reg[op.left], dest, n, timeStep, states[j]); break;
+                case CALL_AVG: average(reg[op.left], dest, n, states[j]); break;
+                case CALL_FFT: transform(reg[op.left], dest, n); break;
+            }
+        }
+
+        memcpy(output + start, reg[result_], n * sizeof(float));
+    }
+}
@@ -9,12 +9,16 @@ ChannelCurve::ChannelCurve(Channel channel, const QString &title,
     timeDiv_ = horizontalDivisions.at(0);
     channel_ = channel;
     selected_ = false;
+    measuredSamples_ = 0;
+    carrierPeriod_ = 0;
+    generation_ = 0;
+    requested_ = 0;
 }
 
 // Sets the vertical scale specific to this curve.
 void ChannelCurve::setScale(double scale) {
     voltageDiv_ = scale;
-    measureCurve();
+    emitMeasurements();
 }
 
 // Returns the Channel that this curve corresponds to.
@@ -60,11 +64,25 @@ bool ChannelCurve::isEmpty() const {
     return dataSize() == 0;
 }
 
-// Called with the current state to begin processing the curve on its own thread.
-void ChannelCurve::process(State state) {
+// Called from the GUI thread with the generation of a frame before it is
+// passed to process, so that older frames still queued are skipped.
+void ChannelCurve::request(quint64 generation) {
+    requested_.storeRelease(generation);
+}
+
+// Called with the current state to begin processing a frame of the curve
+// on a thread of the pool. A frame superseded by a newer request before it
+// was started is dropped.
+void ChannelCurve::process(StateSnapshot state, quint64 generation) {
+    if (generation < requested_.loadAcquire()) {
+        emit finished((int)channel_, generation);
+        return;
+    }
+
     mutex_.lock();
 
     state_ = state;
+    generation_ = generation;
 
     if (channel_ == M) {
         evaluate();
@@ -76,277 +94,306 @@ void ChannelCurve::process(State state) {
 
     measureCurve();
 
-    findFrequency();
+    if (state_->spectrumEnabled()) {
+        emit spectrumReady((int)channel_, spectrum_.calculate(waveform_,
+                                                              state_->getSpectrumWindow(),
+                                                              state_->getSpectrumAverages()));
+    } else {
+        spectrum_.reset();
+    }
 
     mutex_.unlock();
+
+    emit finished((int)channel_, generation);
 }
 
 // Processing function called to translate an acquisition of bit values to
 // voltage values.
 void ChannelCurve::setSamples() {
 
-    QVector<QPointF> data;
-    double voltageDiv = verticalDivisions.at(state_.getVoltageDiv(channel_));
-    double timeDiv = horizontalDivisions.at(state_.getTimeDiv());
-    double resolution = (state_.getBitMode() == EIGHT_BIT) ? qPow(2.0, 8) : qPow(2.0, 12);
+    double voltageDiv = verticalDivisions.at(state_->getVoltageDiv(channel_));
+    double timeDiv = horizontalDivisions.at(state_->getTimeDiv());
+    double resolution = (state_->getBitMode() == EIGHT_BIT) ? qPow(2.0, 8) : qPow(2.0, 12);
     double voltageStep = 10.0 * voltageDiv / resolution;
-    double timeStep = 10.0 * timeDiv / ((double)state_.getNoSamples() - 1.0);
-    double currentVoltage, currentTime = -5.0 * timeDiv;
+    double timeStep = 10.0 * timeDiv / ((double)state_->getNoSamples() - 1.0);
+    double startTime = -5.0 * timeDiv;
 
-    int sampleDiff = state_.getNoSamples() - state_.getAcquisition(channel_).size();
+    SampleSpan<quint16> acquisition = state_->getAcquisition(channel_);
+    int numSamples = qMin(acquisition.size(), (int)state_->getNoSamples());
+    int sampleDiff = state_->getNoSamples() - numSamples;
 
     if (sampleDiff > 0)
-        currentTime += sampleDiff * timeStep;
-
-    for (int i = 0; i < state_.getAcquisition(channel_).size(); i++) {
-        quint16 val = state_.getAcquisition(channel_).at(i);
-        currentVoltage = (val * voltageStep) - (5 * voltageDiv);
+        startTime += sampleDiff * timeStep;
 
-        data.append(QPointF(currentTime, currentVoltage));
-        currentTime += timeStep;
+    Waveform data(startTime, timeStep, numSamples);
+    float* values = data.data();
 
-        if (currentTime == 5.0 * timeDiv) break;
+    for (int i = 0; i < numSamples; i++) {
+        values[i] = (float)((acquisition[i] * voltageStep) - (5 * voltageDiv));
     }
 
-    QwtPlotCurve::setSamples(data);
+    setWaveform(data);
 
-    if (channel_ == A && state_.getFilterMode() == BANDPASS)
+    if (channel_ == A && state_->getFilterMode() == BANDPASS)
         processSamples();
     else
-        emit plotReady((int)channel_, data);
+        emit plotReady((int)channel_, data, generation_);
 }
 
 // Processing function called to calculate and plot the points of the math
 // channel.
 void ChannelCurve::evaluate() {
-    parser_ = new Parser();
-    QVector<QPointF> result;
-
-    if (parser_->checkSymbols(state_.getEquation()) != OK
-            || parser_->parse(state_.getPlotPoints(A),
-                              state_.getPlotPoints(B),
-                              state_.getPlotPoints(F),
-                              state_.getNoSamples(),
-                              horizontalDivisions.at(state_.getTimeDiv()),
-                              &result) != OK) {
-        emit error("Expression could not be evaluated: " + parser_->error());
+    Waveform result;
+
+    // The parser only compiles the equation again when it has changed.
+    if (parser_.checkSymbols(state_->getEquation()) != OK
+            || parser_.parse(state_->getPlotPoints(A),
+                             state_->getPlotPoints(B),
+                             state_->getPlotPoints(F),
+                             state_->getNoSamples(),
+                             horizontalDivisions.at(state_->getTimeDiv()),
+                             &result) != OK) {
+        emit error("Expression could not be evaluated: " + parser_.error());
     } else {
-        QwtPlotCurve::setSamples(result);
+        setWaveform(result);
 
-        emit plotReady((int)channel_, result);
+        emit plotReady((int)channel_, result, generation_);
     }
-
-    delete parser_;
 }
 
 // Processing function to apply the filter and plot the points of the filter
 // channel.
 void ChannelCurve::filter() {
-    QVector<QPointF> samples;
-    QVector<QPointF> output;
-
-    samples = state_.getPlotPoints(state_.getFilterChannel());
+    Waveform samples = state_->getPlotPoints(state_->getFilterChannel());
+    Waveform output(samples.startTime(), samples.timeStep(), samples.size());
 
-    for (int n = 0; n < samples.size(); n++) {
-        double inputVal, outputVal;
-        double filteredVal = 0;
+    const float* input = samples.constData();
+    float* filtered = output.data();
 
-        for (int i = 0; i < state_.getBTaps().size(); i++) {
-            if (n - i < 0) {
-                inputVal = 0;
-            } else {
-                inputVal = samples.at(n - i).y();
-            }
+    if (state_->getFilterType() == FIR) {
+        if (fir_.taps() != state_->getBTaps())
+            fir_.setTaps(state_->getBTaps());
 
-            filteredVal += state_.getBTaps().at(i) * inputVal;
-        }
+        fir_.process(input, filtered, samples.size());
+    } else if (!state_->getSections().isEmpty()) {
+        state_->getSections().process(input, filtered, samples.size());
+    } else {
+        // Direct form, used if the filter could not be factored.
+        QList<double> bTaps = state_->getBTaps();
+        QList<double> aTaps = state_->getATaps();
 
-        if (state_.getFilterType() == IIR) {
-            for (int j = 1; j < state_.getATaps().size(); j++) {
-                if (n - j < 0) {
-                    outputVal = 0;
-                } else {
-                   outputVal = output.at(n - j).y();
-                }
+        for (int n = 0; n < samples.size(); n++) {
+            double filteredVal = 0;
 
-                filteredVal -= state_.getATaps().at(j) * outputVal;
+            for (int i = 0; i < bTaps.size() && i <= n; i++) {
+                filteredVal += bTaps.at(i) * input[n - i];
+            }
 
+            for (int j = 1; j < aTaps.size() && j <= n; j++) {
+                filteredVal -= aTaps.at(j) * filtered[n - j];
             }
 
-            filteredVal /= state_.getATaps().at(0);
+            filtered[n] = (float)(filteredVal / aTaps.at(0));
         }
-
-        output.append(QPointF(samples.at(n).x(), filteredVal));
     }
 
-    QwtPlotCurve::setSamples(output);
+    setWaveform(output);
 
-    emit plotReady((int)channel_, output);
+    emit plotReady((int)channel_, output, generation_);
 }
 
 // Processing function called to process bandpass samples.
 void ChannelCurve::processSamples() {
 
-    QVector<QPointF> newSamples;
-
     // Lower the upsample frequency for higher timespans to limit
     // sample size to 10M.
     int idealFreq = timeDiv_ > 50 ? (MAX_FREQ / (timeDiv_ / 50)) : MAX_FREQ;
 
-    int numSamples = (int)dataSize();
+    int numSamples = waveform_.size();
     double sampleFreq = (double)numSamples / (timeDiv_ / 100.0);
     int iR = (int)(idealFreq / sampleFreq);
     double highFreq = iR * sampleFreq;
 
-    double currentTime = timeDiv_ * -5.0;
+    double startTime = timeDiv_ * -5.0;
     double timeStep = (timeDiv_ * 10.0) / (double)(iR * numSamples);
 
     double* upSamples[1];
     upSamples[0] = new double[iR*numSamples];
-    newSamples.reserve(numSamples * iR);
 
-    for (int i = 0; i < iR*numSamples; i++) {
-        if (i%iR == 0) {
-            upSamples[0][i] = sample(i/iR).y();
-        } else {
-            upSamples[0][i] = 0.0;
-        }
-    }
-
-    Dsp::Filter* f = new Dsp::FilterDesign <Dsp::Butterworth::Design::LowPass <10>, 1>;
-    Dsp::Params params;
-    params[0] = (int)highFreq; // sample rate
-    params[1] = 10; // order
-    params[2] = (highFreq / 2.0) / iR; // cutoff frequency
-    f->setParams(params);
-    f->process(iR*numSamples, upSamples);
-
-    for (int i = 0; i < iR*numSamples; i++) {
-        double carrier = iR*qSin((double)sampleFreq * (i/(double)highFreq) * (2.0 * 3.14159));
-        upSamples[0][i] *= carrier;
-    }
-
-    Dsp::Filter* f2 = new Dsp::FilterDesign <Dsp::Butterworth::Design::BandPass <4>, 1>;
-    Dsp::Params params2;
-    params2[0] = (int)highFreq; // sample rate
-    params2[1] = 4; // order
-    params2[2] = 725000; // centre frequency
-    params2[3] = 150000; // bandwidth
+    // Interpolate up to the high frequency, then modulate onto a carrier at
+    // the input sample rate.
+    interpolator_.setRatio(iR);
+    interpolator_.process(waveform_.constData(), numSamples, upSamples[0]);
 
-    f2->setParams (params2);
-    // this will cause a runtime assertion
-    f2->process (iR*numSamples, upSamples);
+    const QVector<double>& table = carrier(iR);
+    int total = iR*numSamples;
 
+    // Runs of the table are mixed in chunks across the thread pool.
+    double* mixed = upSamples[0];
+    const double* periods = table.constData();
+    int runs = (total + table.size() - 1) / table.size();
+    int length = table.size();
 
-    for (int i = 0; i < iR*numSamples; i++) {
-        newSamples.append(QPointF(currentTime, upSamples[0][i]));
-        currentTime += timeStep;
-    }
+    parallelFor(runs, [=](int begin, int end) {
+        for (int r = begin; r < end; r++) {
+            multiplyInPlace(mixed + r * length, periods, qMin(length, total - r * length));
+        }
+    }, qMax(1, PARALLEL_GRAIN / length));
 
-    QwtPlotCurve::setSamples(newSamples);
+    // The bandpass filter is designed once for each sample rate.
+    Dsp::Filter* bandpass = filters_.bandpass(4, (int)highFreq, 725000, 150000);
+    bandpass->process(total, upSamples);
 
-    emit plotReady((int)channel_, newSamples);
+    // Decimate to the selected band-pass rate, each output is placed at the
+    // centre of the samples it was filtered from.
+    decimator_.setFactor(qRound(highFreq / bandpassRates.at(state_->getBandpassRate())));
+    int factor = decimator_.factor();
+    double outputStart = startTime + (factor - 1 - decimator_.delay()) * timeStep;
 
-    delete[] upSamples[0];
-}
+    Waveform decimated(outputStart, timeStep * factor, total / factor);
+    decimator_.process(upSamples[0], total, decimated.data());
 
-// Function called after plotting to measure the voltage values of the curve.
-void ChannelCurve::measureCurve() {
+    // Slower timebases span more samples than can be shown even at the
+    // lowest rate. Filtering further would remove the band itself, so the
+    // output is reduced to its peaks instead.
+    Waveform newSamples = peaks(decimated, BANDPASS_POINTS_PER_SAMPLE * state_->getNoSamples());
 
-    if (isEmpty()) return;
+    setWaveform(newSamples);
 
-    double voltageDiv = verticalDivisions.at(state_.getVoltageDiv(channel_));
+    emit plotReady((int)channel_, newSamples, generation_);
 
-    double vMax = sample(0).y();
-    double vMin = sample(0).y();
-    double vPp = 0.0;
-    double vAvg = 0.0;
-    double stdDev = 0.0;
-    double total = 0.0;
-    int numSamples = 0;
+    delete[] upSamples[0];
+}
 
-    for (int i = 0; i < (int)dataSize(); i++) {
-        if (sample(i).y() > vMax) {
-            vMax = sample(i).y();
-        }
-        if (sample(i).y() < vMin) {
-            vMin = sample(i).y();
+// Reduces a waveform to at most maxPoints points, keeping the minimum and
+// maximum of each group of samples in the order they occur. The waveform is
+// returned unchanged if it is short enough.
+Waveform ChannelCurve::peaks(const Waveform& waveform, int maxPoints) {
+    int size = waveform.size();
+
+    if (maxPoints < 2 || size <= maxPoints)
+        return waveform;
+
+    // Each group gives two points, so groups hold an even number of samples
+    // and the points are evenly spaced half a group apart.
+    int group = 2 * ((size + maxPoints - 1) / maxPoints);
+    int groups = (size + group - 1) / group;
+    double step = waveform.timeStep() * group / 2;
+    double start = waveform.startTime() + (group / 2 - 1) * waveform.timeStep() / 2;
+
+    Waveform reduced(start, step, 2 * groups);
+    const float* y = waveform.constData();
+    float* values = reduced.data();
+
+    for (int g = 0; g < groups; g++) {
+        const float* samples = y + g * group;
+        int count = qMin(group, size - g * group);
+        int minIndex = 0, maxIndex = 0;
+
+        for (int i = 1; i < count; i++) {
+            if (samples[i] < samples[minIndex]) minIndex = i;
+            if (samples[i] > samples[maxIndex]) maxIndex = i;
         }
 
-        if (sample(i).y() <= voltageDiv * 5.0 && sample(i).y() >= voltageDiv * -5.0) {
-            total += sample(i).y();
-            numSamples++;
-        }
+        values[2 * g] = samples[qMin(minIndex, maxIndex)];
+        values[2 * g + 1] = samples[qMax(minIndex, maxIndex)];
     }
 
-    vMax = qMin(vMax, voltageDiv * 5.0);
-    vMin = qMax(vMin, voltageDiv * -5.0);
-    vPp = vMax - vMin;
-    vAvg = total / (double)(numSamples);
+    return reduced;
+}
 
-    for (int i = 0; i < (int)dataSize(); i++) {
-        if (sample(i).y() < voltageDiv * 5.0 && sample(i).y() >= voltageDiv * -5.0) {
-            stdDev += qPow(sample(i).y() - vAvg, 2);
+// Returns whole periods of the carrier mixed with the upsampled bandpass
+// samples. The high frequency is a whole multiple of the input sample rate,
+// so the carrier repeats every period samples and the table is only
+// calculated again when the interpolation ratio changes.
+const QVector<double>& ChannelCurve::carrier(int period) {
+    if (period != carrierPeriod_) {
+        carrierPeriod_ = period;
+        int periods = (MIN_CARRIER_TABLE + period - 1) / period;
+        carrier_.resize(periods * period);
+
+        for (int i = 0; i < carrier_.size(); i++) {
+            carrier_[i] = qSin(2.0 * M_PI * (i % period) / period);
         }
     }
 
-    stdDev = qSqrt(stdDev / (double)(numSamples));
-
-    emit measured((int)channel_, vMax, vMin, vPp, vAvg, stdDev);
+    return carrier_;
 }
 
-// Processing function called after plotting to find the frequency of the
-// curve.
-void ChannelCurve::findFrequency() {
-
-        int size = (int)dataSize();
-        if (size == 0) {
-            emit freqCalculated((int)channel_, 0.0);
-            return;
-        }
-
-        double *samples = new double[size];
-
-        double *fft = new double[size];
-
-        for(int i = 0; i < size; i++) {
-            samples[i] = sample(i).y();
-        }
-
-        fftw_plan plan = fftw_plan_r2r_1d(size, samples, fft, FFTW_R2HC, FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
-        fftw_execute(plan);
+// Sets the waveform plotted by this curve, and builds the min/max pyramid
+// used to draw it at any horizontal scale in time proportional to the width
+// of the canvas rather than the number of samples.
+void ChannelCurve::setWaveform(const Waveform& waveform) {
+    waveform_ = waveform;
+    setData(new WaveformData(waveform));
 
-        double max = 0.0;
-        double finalFreq = 0.0;
-        bool peakFound = false;
-        double peakVal = 0.0;
+    MinMaxPyramid pyramid;
+    pyramid.build(waveform);
 
-        double freqStep = 1 / (((timeDiv_ / 100.0) / (double)dataSize()) * size);
-        double currentFreq = 0.0;
-
-        for (int i = 0; i < (size / 2) + 1; i++) {
-
-            fft[i] = qFabs(fft[i]);
-
-            if (i > 0 && fft[i] > (max + 0.000001) && (!peakFound || fft[i] > 1.2 * peakVal)) {
-                max = fft[i];
-                finalFreq = currentFreq;
-            }
+    pyramidMutex_.lock();
+    pyramid_ = pyramid;
+    pyramidMutex_.unlock();
+}
 
-            if ( i > 0 && fft[i] < (fft[i-1] - 0.000001) && finalFreq > 0.0 && finalFreq == currentFreq - freqStep) {
-                peakFound = true;
-                peakVal = fft[i-1];
-            }
+// Function called after plotting to measure the curve. The voltage
+// statistics are found first, then the pulses are timed in a single pass
+// using the range of the statistics, and the frequency is refined from the
+// spectrum.
+void ChannelCurve::measureCurve() {
+    double voltageDiv = verticalDivisions.at(state_->getVoltageDiv(channel_));
+    double resolution = (state_->getBitMode() == EIGHT_BIT) ? qPow(2.0, 8) : qPow(2.0, 12);
+    double voltageStep = 10.0 * voltageDiv / resolution;
+    const float* y = waveform_.constData();
+    int size = waveform_.size();
+
+    // Samples at either end of the range of the ADC are clipped.
+    SampleStats stats = measureSamples(y, size, -5.0 * voltageDiv,
+                                       5.0 * voltageDiv - voltageStep);
+    PulseStats pulses = measurePulses(y, size, waveform_.timeStep(), stats.min, stats.max);
+    FrequencyMeasurement frequency = frequencyMeter_.measure(waveform_, pulses);
+
+    Measurements measurements;
+    measurements.max = stats.max;
+    measurements.min = stats.min;
+    measurements.peakToPeak = stats.max - stats.min;
+    measurements.mean = stats.mean;
+    measurements.stdDev = qSqrt(stats.variance);
+    measurements.rms = stats.rms;
+    measurements.clippedLow = stats.clippedLow;
+    measurements.clippedHigh = stats.clippedHigh;
+    measurements.frequency = frequency.frequency;
+    measurements.period = frequency.period;
+    measurements.dutyCycle = frequency.dutyCycle;
+    measurements.riseTime = pulses.riseTime;
+    measurements.fallTime = pulses.fallTime;
+    measurements.positiveWidth = pulses.positiveWidth;
+    measurements.negativeWidth = pulses.negativeWidth;
+    measurements.overshoot = pulses.overshoot;
+    measurements.undershoot = pulses.undershoot;
+    measurements.cycleRms = (pulses.periods > 0) ? pulses.cycleRms : -1.0;
+
+    measurementsMutex_.lock();
+    measurements_ = measurements;
+    measuredSamples_ = stats.count;
+    measurementsMutex_.unlock();
+
+    emitMeasurements();
+}
 
-            currentFreq += freqStep;
-        }
+// Emits the measurements of the current frame, with the maximum and minimum
+// limited to the vertical range of the curve. Called again when the curve is
+// rescaled, without measuring the frame again.
+void ChannelCurve::emitMeasurements() {
+    QMutexLocker locker(&measurementsMutex_);
 
-        fftw_destroy_plan(plan);
+    if (measuredSamples_ == 0) return;
 
-        delete [] samples;
-        delete [] fft;
+    Measurements measurements = measurements_;
+    measurements.max = qMin(measurements.max, voltageDiv_ * 5.0);
+    measurements.min = qMax(measurements.min, voltageDiv_ * -5.0);
+    measurements.peakToPeak = measurements.max - measurements.min;
 
-        emit freqCalculated((int)channel_, finalFreq);
+    emit measured((int)channel_, measurements);
 }
 
 // Override function to set the channels unique scale before calling
@@ -357,5 +404,50 @@ void ChannelCurve::draw (QPainter* painter, const QwtScaleMap& xMap, const QwtSc
     double maxY = voltageDiv_ * 5.0;
     QwtScaleMap newYMap (yMap);
     newYMap.setScaleInterval (minY, maxY);
-    QwtPlotCurve::draw (painter, xMap, newYMap, rect);
+
+    if (!drawEnvelope(painter, xMap, newYMap))
+        QwtPlotCurve::draw (painter, xMap, newYMap, rect);
+}
+
+// Draws the min/max envelope of the curve as a vertical line per pixel
+// column. Returns false if the curve has few enough samples at the current
+// horizontal scale to be drawn from its samples.
+bool ChannelCurve::drawEnvelope(QPainter* painter, const QwtScaleMap& xMap,
+                                const QwtScaleMap& yMap) const {
+    QMutexLocker locker(&pyramidMutex_);
+
+    if (pyramid_.isEmpty() || pyramid_.levelFor(xMap) == 0)
+        return false;
+
+    Envelope envelope = pyramid_.envelope(xMap);
+    int columns = envelope.columns();
+    double columnWidth = (envelope.endTime - envelope.startTime) / columns;
+    QPolygonF polyline;
+    polyline.reserve(2 * columns);
+
+    for (int c = 0; c < columns; c++) {
+        float minY = envelope.min.at(c);
+        float maxY = envelope.max.at(c);
+
+        if (minY > maxY) continue;
+
+        double x = xMap.transform(envelope.startTime + (c + 0.5) * columnWidth);
+
+        // Alternate the direction of each column's line so consecutive
+        // columns join at the nearest end.
+        if (c % 2 == 0) {
+            polyline.append(QPointF(x, yMap.transform(minY)));
+            polyline.append(QPointF(x, yMap.transform(maxY)));
+        } else {
+            polyline.append(QPointF(x, yMap.transform(maxY)));
+            polyline.append(QPointF(x, yMap.transform(minY)));
+        }
+    }
+
+    painter->save();
+    painter->setPen(pen());
+    QwtPainter::drawPolyline(painter, polyline);
+    painter->restore();
+
+    return true;
 }
@@ -0,0 +1,56 @@
+#include "cicdecimator.h"
+
+CicDecimator::CicDecimator()
+{
+    factor_ = 1;
+}
+
+// Sets the number of input samples for each output sample.
+void CicDecimator::setFactor(int factor) {
+    factor_ = qBound(1, factor, MAX_CIC_FACTOR);
+}
+
+// Returns the number of input samples for each output sample.
+int CicDecimator::factor() const {
+    return factor_;
+}
+
+// Returns the time from the last input sample of each output to the centre
+// of its response, in input samples.
+double CicDecimator::delay() const {
+    return CIC_STAGES * (factor_ - 1) / 2.0;
+}
+
+// Decimates count input samples into count / factor output samples and
+// returns the number of outputs. Output i is taken after input
+// (i + 1) * factor - 1. The gain of the filter is removed.
+int CicDecimator::process(const double* input, int count, float* output) const {
+    quint64 integrators[CIC_STAGES] = {0};
+    quint64 combs[CIC_STAGES] = {0};
+    double gain = 1.0 / (CIC_SCALE * qPow(factor_, CIC_STAGES));
+    int outputs = 0;
+    int phase = 0;
+
+    for (int i = 0; i < count; i++) {
+        integrators[0] += (quint64)qRound64(input[i] * CIC_SCALE);
+        for (int s = 1; s < CIC_STAGES; s++) {
+            integrators[s] += integrators[s - 1];
+        }
+
+        if (++phase < factor_)
+            continue;
+
+        phase = 0;
+        quint64 value = integrators[CIC_STAGES - 1];
+
+        for (int s = 0; s < CIC_STAGES; s++) {
+            quint64 difference = value - combs[s];
+            combs[s] = value;
+            value = difference;
+        }
+
+        output[outputs++] = (float)((qint64)value * gain);
+    }
+
+    return outputs;
+}
@@ -3,23 +3,21 @@
 CommunicationHandler::CommunicationHandler(State *state, QObject* parent) : QObject(parent)
 {
     connected_ = false;
+    decoding_ = false;
     socket_ = new QTcpSocket();
     stream_.setDevice(socket_);
     state_ = state;
 
-    readTimer_ = new QTimer(this);
-    readTimer_->setInterval(2);
-
     keepAliveTimer_ = new QTimer(this);
     keepAliveTimer_->setInterval(1000);
 
-    QObject::connect(readTimer_, &QTimer::timeout, this, &CommunicationHandler::read);
     QObject::connect(keepAliveTimer_, &QTimer::timeout, this, &CommunicationHandler::handShake);
 
     QObject::connect(socket_, &QTcpSocket::connected, this, &CommunicationHandler::connected);
     QObject::connect(socket_, &QTcpSocket::disconnected, this, &CommunicationHandler::disconnected);
     QObject::connect(socket_, &QTcpSocket::bytesWritten, this, &CommunicationHandler::bytesWritten);
     QObject::connect(socket_, &QTcpSocket::aboutToClose, this, &CommunicationHandler::closing);
+    QObject::connect(socket_, &QTcpSocket::readyRead, this, &CommunicationHandler::read);
 }
 
 void CommunicationHandler::connect(QString hostName) {
@@ -39,179 +37,174 @@ void CommunicationHandler::closeConnection() {
     }
 }
 
+// Called whenever the socket has new data. Appends the received bytes to the
+// pending buffer and decodes every complete message it contains, leaving any
+// partially received message in the buffer until the rest of it arrives.
 void CommunicationHandler::read() {
 
-    if (socket_->bytesAvailable() == 0) return;
+    // Signals emitted while decoding may write to the socket, which can
+    // re-enter this slot. Any data received meanwhile is picked up by the
+    // outer loop instead.
+    if (decoding_) return;
+    decoding_ = true;
+
+    while (socket_->bytesAvailable() > 0) {
+        buffer_.append(socket_->readAll());
+
+        const uchar* data = (const uchar*)buffer_.constData();
+        int size = buffer_.size();
+        int offset = 0;
+
+        while (offset < size) {
+            int length = messageLength(data + offset, size - offset);
 
-    qDebug() << socket_->bytesAvailable() << " bytes available";
+            if (length == 0 || length > size - offset)
+                break;
 
-    char *header = (char*)malloc(sizeof(char));
-    char *channel = (char*)malloc(sizeof(char));
-    char *option = (char*)malloc(sizeof(char));
+            decode(data + offset);
+            offset += length;
+        }
 
-    quint16 data;
-    quint8 byte;
-    quint16 mask = state_->getBitMode() == EIGHT_BIT ? 0xFF : 0xFFF;
+        if (offset > 0)
+            buffer_.remove(0, offset);
+    }
 
-    quint16 numSamples = 0, lastFlag = 0;
-    QList<quint16> acquisition;
-    acquisition.clear();
+    decoding_ = false;
+}
 
-    stream_.readRawData(header, 1);
-    MessageType type = (MessageType)(*header - 'a');
+// Returns the total length in bytes of the message starting at msg, or 0 if
+// not enough of the message has been received to determine its length.
+int CommunicationHandler::messageLength(const uchar* msg, int available) const {
+    MessageType type = (MessageType)(msg[0] - 'a');
+
+    switch(type) {
+        case VOLTAGE_ERROR:
+            return 1;
+        case ACQUISITION:
+        {
+            if (available < 4)
+                return 0;
+            int numSamples = 0x7FFF & qFromBigEndian<quint16>(msg + 2);
+            int sampleSize = state_->getBitMode() == EIGHT_BIT ? 1 : 2;
+            return 4 + numSamples * sampleSize;
+        }
+        case BIT_MODE:
+        case FILTER_MODE:
+        case HORIZONTAL_RANGE:
+        case TRIGGER_STATUS:
+        case TRIGGER_CHANNEL:
+        case TRIGGER_MODE:
+        case TRIGGER_TYPE:
+        case FUNCTION_STATE:
+        case FUNCTION_WAVE:
+        case FUNCTION_VOLTAGE:
+            return 2;
+        case NO_SAMPLES:
+        case COUPLING:
+        case VERTICAL_RANGE:
+        case TRIGGER_THRESHOLD:
+        case FUNCTION_OFFSET:
+        case FUNCTION_FREQ:
+            return 3;
+        case OFFSET:
+            return 4;
+        default:
+            // Unknown message types are skipped a byte at a time so the
+            // decoder can resynchronise with the stream.
+            return 1;
+    }
+}
+
+// Decodes a single complete message and emits the corresponding signal.
+void CommunicationHandler::decode(const uchar* msg) {
+    MessageType type = (MessageType)(msg[0] - 'a');
 
     switch(type) {
         case VOLTAGE_ERROR:
             emit voltageError();
             break;
         case ACQUISITION:
-            if (socket_->bytesAvailable() < 3)
-                break;
-
-            stream_.readRawData(channel, 1);          
-            stream_ >> numSamples;
-            numSamples = ntohs(numSamples);
-            lastFlag = 0x8000 & numSamples;
-            numSamples = 0x7FFF & numSamples;
-
-            qDebug() << "Samples in packet: " << numSamples;
-
-            if (state_->getBitMode() == EIGHT_BIT)
-                qDebug() << "8 Bit";
-            for (int i = 0; i < numSamples; i++) {
-                if (state_->getBitMode() == TWELVE_BIT) {
-                    stream_ >> data;
-                    acquisition.append(ntohs(data) & mask);
-                } else {
-                    stream_ >> byte;
-                    acquisition.append((quint16)ntohs(byte));
-                }
+        {
+            Channel channel = (Channel)(msg[1] - '0');
+            quint16 header = qFromBigEndian<quint16>(msg + 2);
+            bool last = (0x8000 & header) != 0;
+            int numSamples = 0x7FFF & header;
+            const uchar* payload = msg + 4;
+
+            packet_.resize(numSamples);
+
+            if (state_->getBitMode() == TWELVE_BIT) {
+                unpackTwelveBit(payload, packet_.data(), numSamples);
+            } else {
+                unpackEightBit(payload, packet_.data(), numSamples);
             }
 
-            qDebug() << "Number of samples: " << acquisition.size();
+            state_->setAcquisition(channel, packet_.constData(), numSamples);
 
-            state_->setAcquisition((Channel)(*channel - '0'), acquisition);
-
-            qDebug() << acquisition;
-            if (lastFlag != 0) {
-                qDebug() << "A size: " << state_->getAcquisition(A).size();
-                emit acquisitionReady((int)(*channel - '0'));
-                acquisition.clear();
+            if (last) {
+                emit acquisitionReady((int)channel);
             }
 
             break;
+        }
         case NO_SAMPLES:
-            if (socket_->bytesAvailable() < 2)
-                break;
-            stream_ >> data;
-            emit numSamplesChanged(ntohs(data));
+            emit numSamplesChanged(qFromBigEndian<quint16>(msg + 1));
             break;
         case BIT_MODE:
-            if (socket_->bytesAvailable() < 1)
-                break;
-            stream_.readRawData(option, 1);
-            emit bitModeChanged((int)('B' - *option));
+            emit bitModeChanged((int)('B' - msg[1]));
             break;
         case FILTER_MODE:
-            if (socket_->bytesAvailable() < 1)
-                break;
-            stream_.readRawData(option, 1);
-            emit aFilterModeChanged((int)(*option - 'A'));
+            emit aFilterModeChanged((int)(msg[1] - 'A'));
             break;
         case COUPLING:
-            if (socket_->bytesAvailable() < 2)
-                break;
-            stream_.readRawData(channel, 1);
-            stream_.readRawData(option, 1);
-            emit couplingChanged((int)(*channel - '0'), (int)(*option - 'A'));
+            emit couplingChanged((int)(msg[1] - '0'), (int)(msg[2] - 'A'));
             break;
         case VERTICAL_RANGE:
-            if (socket_->bytesAvailable() < 2)
-                break;
-            stream_.readRawData(channel, 1);
-            stream_.readRawData(option, 1);
-            emit vScaleChanged((int)(*channel - '0'), (int)('G' - *option));
+            emit vScaleChanged((int)(msg[1] - '0'), (int)('G' - msg[2]));
             break;
         case OFFSET:
-            if (socket_->bytesAvailable() < 3)
-                break;
-            stream_.readRawData(channel, 1);
-            stream_ >> data;
-            emit offsetChanged((int)(*channel - '0'), ntohs(data));
+            emit offsetChanged((int)(msg[1] - '0'), qFromBigEndian<quint16>(msg + 2));
             break;
         case HORIZONTAL_RANGE:
-            if (socket_->bytesAvailable() < 1)
-                break;
-            stream_.readRawData(option, 1);
-            emit hScaleChanged((int)('S' - *option));
+            emit hScaleChanged((int)('S' - msg[1]));
             break;
         case TRIGGER_STATUS:
-            if (socket_->bytesAvailable() < 1)
-                break;
-            stream_.readRawData(option, 1);
-            emit triggerStatusChanged((int)(*option - 'A'));
+            emit triggerStatusChanged((int)(msg[1] - 'A'));
             break;
         case TRIGGER_CHANNEL:
-            if (socket_->bytesAvailable() < 1)
-                break;
-            stream_.readRawData(channel, 1);
-            emit triggerChannelChanged((int)(*channel - '0'));
+            emit triggerChannelChanged((int)(msg[1] - '0'));
             break;
         case TRIGGER_MODE:
-            if (socket_->bytesAvailable() < 1)
-                break;
-            stream_.readRawData(option, 1);
-            emit triggerModeChanged((int)(*option - 'A'));
+            emit triggerModeChanged((int)(msg[1] - 'A'));
             break;
         case TRIGGER_TYPE:
-            if (socket_->bytesAvailable() < 1)
-                break;
-            stream_.readRawData(option, 1);
-            emit triggerTypeChanged((int)(*option - 'A'));
+            emit triggerTypeChanged((int)(msg[1] - 'A'));
             break;
         case TRIGGER_THRESHOLD:
-            if (socket_->bytesAvailable() < 2)
-                break;
-            stream_ >> data;
-            emit triggerThresholdChanged(ntohs(data));
+            emit triggerThresholdChanged(qFromBigEndian<quint16>(msg + 1));
             break;
         case FUNCTION_STATE:
-            if (socket_->bytesAvailable() < 1)
-                break;
-            stream_.readRawData(option, 1);
-            emit functionGenEnabled(((int)(*option - 'A') == ON));
+            emit functionGenEnabled(((int)(msg[1] - 'A') == ON));
             break;
         case FUNCTION_WAVE:
-            if (socket_->bytesAvailable() < 1)
-                break;
-            stream_.readRawData(option, 1);
-            emit functionGenWaveChanged((int)(*option - 'A'));
+            emit functionGenWaveChanged((int)(msg[1] - 'A'));
             break;
         case FUNCTION_VOLTAGE:
-            if (socket_->bytesAvailable() < 1)
-                break;
-            stream_.readRawData(option, 1);
-            emit functionGenVoltageChanged((int)(*option - 'A'));
+            emit functionGenVoltageChanged((int)(msg[1] - 'A'));
             break;
         case FUNCTION_OFFSET:
-            if (socket_->bytesAvailable() < 2)
-                break;
-            stream_ >> data;
-            emit functionGenOffsetChanged(ntohs(data));
+            emit functionGenOffsetChanged(qFromBigEndian<quint16>(msg + 1));
             break;
         case FUNCTION_FREQ:
         {
-            if (socket_->bytesAvailable() < 2)
-                break;
-            stream_ >> data;
-            quint16 freq = state_->functionFreqs_.indexOf(ntohs(data));
+            quint16 freq = state_->functionFreqs_.indexOf(qFromBigEndian<quint16>(msg + 1));
             if (freq > 0) {
                 emit functionGenFreqChanged(freq);
             }
             break;
         }
         default:
-            qDebug() << "Invalid message type: " << QString(header);
+            qDebug() << "Invalid message type: " << QString(QChar(msg[0]));
     }
 }
 
@@ -501,8 +494,8 @@ void CommunicationHandler::bytesWritten(qint64 bytes) {
 void CommunicationHandler::connected() {
     qDebug() << "Connected to " << socket_->peerName();
     connected_ = true;
+    buffer_.clear();
     emit deviceConnected(socket_->peerName());
-    readTimer_->start();
     //keepAliveTimer_->start();
     handShake();
 }
@@ -510,7 +503,6 @@ void CommunicationHandler::connected() {
 void CommunicationHandler::disconnected() {
     qDebug() << "Disconnected.";
     connected_ = false;
-    readTimer_->stop();
     //keepAliveTimer_->stop();
     if (socket_->isOpen())
         socket_->close();
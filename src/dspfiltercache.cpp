@@ -0,0 +1,57 @@
+#include "dspfiltercache.h"
+
+// Returns true if both keys have the same parameters.
+bool DspFilterKey::operator==(const DspFilterKey& other) const {
+    return order == other.order && sampleRate == other.sampleRate
+            && frequency == other.frequency && bandwidth == other.bandwidth;
+}
+
+// Hash of a filter key for QHash.
+uint qHash(const DspFilterKey& key, uint seed) {
+    return qHash(key.order, seed) ^ qHash(key.sampleRate, seed)
+            ^ qHash(key.frequency, seed) ^ qHash(key.bandwidth, seed);
+}
+
+DspFilterCache::DspFilterCache()
+{
+}
+
+DspFilterCache::~DspFilterCache() {
+    clear();
+}
+
+// Returns a bandpass filter of the given order, sample rate, centre
+// frequency and bandwidth, with its state reset. The filter is designed the
+// first time it is requested. Orders above MAX_BANDPASS_ORDER are limited to
+// it.
+Dsp::Filter* DspFilterCache::bandpass(int order, double sampleRate, double frequency,
+                                      double bandwidth) {
+    order = qBound(1, order, MAX_BANDPASS_ORDER);
+
+    DspFilterKey key = {order, sampleRate, frequency, bandwidth};
+    Dsp::Filter* filter = filters_.value(key, NULL);
+
+    if (filter == NULL) {
+        if (filters_.size() >= MAX_CACHED_FILTERS)
+            clear();
+
+        Dsp::Params params;
+        params[0] = sampleRate;
+        params[1] = order;
+        params[2] = frequency;
+        params[3] = bandwidth;
+
+        filter = new Dsp::FilterDesign <Dsp::Butterworth::Design::BandPass <MAX_BANDPASS_ORDER>, 1>;
+        filter->setParams(params);
+        filters_.insert(key, filter);
+    }
+
+    filter->reset();
+    return filter;
+}
+
+// Deletes every cached filter.
+void DspFilterCache::clear() {
+    qDeleteAll(filters_);
+    filters_.clear();
+}
@@ -0,0 +1,108 @@
+#include "fftplancache.h"
+
+// The FFTW planner is not thread safe, so every plan is created and
+// destroyed while this lock is held.
+static QMutex planner;
+
+static QThreadStorage<FftPlanCache*> caches;
+
+FftPlanCache::FftPlanCache()
+{
+
+}
+
+FftPlanCache::~FftPlanCache() {
+    foreach (FftPlan* plan, plans_) {
+        destroy(plan);
+    }
+}
+
+// Returns the plan cache of the calling thread, creating it on first use.
+// The cache is deleted when the thread exits.
+FftPlanCache* FftPlanCache::local() {
+    if (!caches.hasLocalData())
+        caches.setLocalData(new FftPlanCache());
+
+    return caches.localData();
+}
+
+// Returns a plan for a transform of the given size. The plan's buffers are
+// owned by the cache and reused by later calls.
+const FftPlan* FftPlanCache::plan(int size) {
+    FftPlan* plan = plans_.value(size, NULL);
+
+    if (plan != NULL) {
+        recent_.removeOne(size);
+        recent_.append(size);
+        return plan;
+    }
+
+    if (plans_.size() >= MAX_CACHED_PLANS) {
+        int oldest = recent_.takeFirst();
+        destroy(plans_.take(oldest));
+    }
+
+    plan = create(size);
+    plans_.insert(size, plan);
+    recent_.append(size);
+
+    return plan;
+}
+
+// Returns the lock that must be held while using the FFTW planner.
+QMutex* FftPlanCache::plannerLock() {
+    return &planner;
+}
+
+// Loads the FFTW wisdom saved by a previous session, so that measured plans
+// are created without measuring them again.
+void FftPlanCache::loadWisdom() {
+    QMutexLocker locker(&planner);
+
+    if (!fftw_import_wisdom_from_filename(wisdomPath().toLocal8Bit().constData()))
+        qDebug() << "No FFTW wisdom loaded.";
+}
+
+// Saves the FFTW wisdom gathered during this session.
+void FftPlanCache::saveWisdom() {
+    QString path = wisdomPath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QMutexLocker locker(&planner);
+
+    if (!fftw_export_wisdom_to_filename(path.toLocal8Bit().constData()))
+        qDebug() << "FFTW wisdom could not be saved to " << path;
+}
+
+// Allocates the buffers of a new plan and plans the transform.
+FftPlan* FftPlanCache::create(int size) {
+    FftPlan* plan = new FftPlan();
+    plan->size = size;
+    plan->input = (double*)fftw_malloc(size * sizeof(double));
+    plan->spectrum = (fftw_complex*)fftw_malloc((size / 2 + 1) * sizeof(fftw_complex));
+
+    unsigned flags = (size <= MAX_MEASURED_SIZE) ? FFTW_MEASURE : FFTW_ESTIMATE;
+
+    QMutexLocker locker(&planner);
+    plan->plan = fftw_plan_dft_r2c_1d(size, plan->input, plan->spectrum,
+                                      flags | FFTW_PRESERVE_INPUT);
+
+    return plan;
+}
+
+// Destroys a plan and frees its buffers.
+void FftPlanCache::destroy(FftPlan* plan) {
+    planner.lock();
+    fftw_destroy_plan(plan->plan);
+    planner.unlock();
+
+    fftw_free(plan->input);
+    fftw_free(plan->spectrum);
+    delete plan;
+}
+
+// Returns the path of the file the FFTW wisdom is saved in.
+QString FftPlanCache::wisdomPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+            + "/fftw.wisdom";
+}
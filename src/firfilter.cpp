@@ -0,0 +1,243 @@
+#include "firfilter.h"
+
+int FirFilter::crossover_ = DEFAULT_FIR_CROSSOVER;
+
+FirFilter::FirFilter()
+{
+    taps_ = NULL;
+    length_ = 0;
+    fftSize_ = 0;
+    block_ = NULL;
+    spectrum_ = NULL;
+    response_ = NULL;
+    forward_ = NULL;
+    inverse_ = NULL;
+}
+
+FirFilter::~FirFilter() {
+    releasePlans();
+
+    if (taps_ != NULL)
+        fftw_free(taps_);
+}
+
+// Sets the taps of the filter. The taps are stored in reverse order so each
+// output sample is a dot product with a contiguous window of the input.
+void FirFilter::setTaps(const QList<double>& taps) {
+    releasePlans();
+
+    if (taps_ != NULL)
+        fftw_free(taps_);
+
+    tapList_ = taps;
+    length_ = taps.size();
+    taps_ = (double*)fftw_malloc(qMax(1, length_) * sizeof(double));
+
+    for (int i = 0; i < length_; i++) {
+        taps_[i] = taps.at(length_ - 1 - i);
+    }
+}
+
+// Returns the taps of the filter.
+QList<double> FirFilter::taps() const {
+    return tapList_;
+}
+
+// Returns the number of taps of the filter.
+int FirFilter::length() const {
+    return length_;
+}
+
+// Filters count samples of input into output, treating samples before the
+// start of the input as zero.
+void FirFilter::process(const float* input, float* output, int count) {
+    if (count <= 0) return;
+
+    if (length_ == 0) {
+        for (int i = 0; i < count; i++) {
+            output[i] = 0.0f;
+        }
+        return;
+    }
+
+    // Zero pad the start of the input by one less than the filter length.
+    padded_.resize(length_ - 1 + count);
+    double* padded = padded_.data();
+
+    for (int i = 0; i < length_ - 1; i++) {
+        padded[i] = 0.0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        padded[length_ - 1 + i] = input[i];
+    }
+
+    if (length_ > crossover_ && count > length_)
+        processFft(output, count);
+    else
+        processDirect(output, count);
+}
+
+// Direct convolution of the padded input, split into chunks across the
+// thread pool.
+void FirFilter::processDirect(float* output, int count) {
+    parallelFor(count, [=](int begin, int end) {
+        convolve(output, begin, end);
+    }, qMax(1, PARALLEL_GRAIN / qMax(1, length_)));
+}
+
+// Direct convolution of the outputs in [begin, end), one vectorised dot
+// product per output sample.
+void FirFilter::convolve(float* output, int begin, int end) const {
+    const double* padded = padded_.constData();
+
+    for (int n = begin; n < end; n++) {
+        output[n] = (float)dotProduct(taps_, padded + n, length_);
+    }
+}
+
+// Overlap-save convolution of the padded input. Each block of the input is transformed,
+// multiplied by the frequency response of the filter and transformed back,
+// the first length - 1 outputs of each block are discarded.
+void FirFilter::processFft(float* output, int count) {
+    int size = 1;
+    while (size < 4 * length_) size <<= 1;
+
+    if (size != fftSize_)
+        preparePlans(size);
+
+    const double* padded = padded_.constData();
+    int available = padded_.size();
+    int step = fftSize_ - length_ + 1;
+    int bins = fftSize_ / 2 + 1;
+    double scale = 1.0 / fftSize_;
+
+    for (int start = 0; start < count; start += step) {
+        int copy = qMin(fftSize_, available - start);
+
+        for (int i = 0; i < copy; i++) {
+            block_[i] = padded[start + i];
+        }
+
+        for (int i = copy; i < fftSize_; i++) {
+            block_[i] = 0.0;
+        }
+
+        fftw_execute(forward_);
+
+        for (int k = 0; k < bins; k++) {
+            double re = spectrum_[k][0] * response_[k][0] - spectrum_[k][1] * response_[k][1];
+            double im = spectrum_[k][0] * response_[k][1] + spectrum_[k][1] * response_[k][0];
+            spectrum_[k][0] = re;
+            spectrum_[k][1] = im;
+        }
+
+        fftw_execute(inverse_);
+
+        int outputs = qMin(step, count - start);
+
+        for (int i = 0; i < outputs; i++) {
+            output[start + i] = (float)(block_[length_ - 1 + i] * scale);
+        }
+    }
+}
+
+// Allocates the FFT buffers and plans for the given transform size, and
+// calculates the frequency response of the filter.
+void FirFilter::preparePlans(int size) {
+    releasePlans();
+
+    fftSize_ = size;
+    int bins = size / 2 + 1;
+    block_ = (double*)fftw_malloc(size * sizeof(double));
+    spectrum_ = (fftw_complex*)fftw_malloc(bins * sizeof(fftw_complex));
+    response_ = (fftw_complex*)fftw_malloc(bins * sizeof(fftw_complex));
+
+    FftPlanCache::plannerLock()->lock();
+    forward_ = fftw_plan_dft_r2c_1d(size, block_, spectrum_, FFTW_ESTIMATE);
+    inverse_ = fftw_plan_dft_c2r_1d(size, spectrum_, block_, FFTW_ESTIMATE);
+    FftPlanCache::plannerLock()->unlock();
+
+    // The taps are stored reversed, restore their order for the response.
+    for (int i = 0; i < size; i++) {
+        block_[i] = (i < length_) ? taps_[length_ - 1 - i] : 0.0;
+    }
+
+    fftw_execute(forward_);
+
+    for (int k = 0; k < bins; k++) {
+        response_[k][0] = spectrum_[k][0];
+        response_[k][1] = spectrum_[k][1];
+    }
+}
+
+// Frees the FFT buffers and plans.
+void FirFilter::releasePlans() {
+    if (fftSize_ == 0) return;
+
+    FftPlanCache::plannerLock()->lock();
+    fftw_destroy_plan(forward_);
+    fftw_destroy_plan(inverse_);
+    FftPlanCache::plannerLock()->unlock();
+
+    fftw_free(block_);
+    fftw_free(spectrum_);
+    fftw_free(response_);
+
+    fftSize_ = 0;
+    block_ = NULL;
+    spectrum_ = NULL;
+    response_ = NULL;
+    forward_ = NULL;
+    inverse_ = NULL;
+}
+
+// Times direct and FFT convolution of a full capture for increasing filter
+// lengths, and sets the crossover to the shortest filter for which FFT
+// convolution is faster. Called once at startup. Both are timed on the
+// calling thread only: while acquiring, every channel is processed on the
+// pool at once, so a filter cannot count on the other threads being idle.
+void FirFilter::measureCrossover() {
+    const int samples = 25000;
+    QVector<float> input(samples), output(samples);
+
+    for (int i = 0; i < samples; i++) {
+        input[i] = (float)((i * 7919) % 1000) / 1000.0f;
+    }
+
+    crossover_ = 1024;
+
+    for (int length = 8; length <= 1024; length *= 2) {
+        QList<double> taps;
+        for (int i = 0; i < length; i++) {
+            taps.append(1.0 / length);
+        }
+
+        FirFilter filter;
+        filter.setTaps(taps);
+
+        // Run both once before timing, so the input is padded and the FFT
+        // plans and frequency response are prepared.
+        filter.process(input.constData(), output.data(), samples);
+        filter.processFft(output.data(), samples);
+
+        QElapsedTimer timer;
+        timer.start();
+        filter.convolve(output.data(), 0, samples);
+        qint64 direct = timer.nsecsElapsed();
+
+        timer.restart();
+        filter.processFft(output.data(), samples);
+        qint64 fft = timer.nsecsElapsed();
+
+        if (fft < direct) {
+            crossover_ = length / 2;
+            break;
+        }
+    }
+}
+
+// Returns the tap count above which FFT convolution is used.
+int FirFilter::crossover() {
+    return crossover_;
+}
@@ -0,0 +1,100 @@
+#include "frequencymeter.h"
+
+FrequencyMeter::FrequencyMeter()
+{
+
+}
+
+// Returns the frequency, period and duty cycle of the waveform, given the
+// measurements of its pulses, or a frequency of 0 if no periodic component
+// is found.
+FrequencyMeasurement FrequencyMeter::measure(const Waveform& waveform, const PulseStats& pulses) {
+    FrequencyMeasurement result = {0.0, 0.0, -1.0};
+
+    double binWidth = 0.0;
+    double frequency = spectralPeak(waveform, &binWidth);
+
+    if (pulses.periods > 0
+            && (frequency == 0.0
+                || qAbs(pulses.frequency - frequency) <= CROSSING_TOLERANCE * binWidth)) {
+        frequency = pulses.frequency;
+        result.dutyCycle = pulses.dutyCycle;
+    }
+
+    if (frequency > 0.0) {
+        result.frequency = frequency;
+        result.period = 1.0 / frequency;
+    }
+
+    return result;
+}
+
+// Returns the frequency of the largest peak of the Hann windowed spectrum,
+// interpolated between bins by fitting a parabola to the logarithm of the
+// magnitudes around it. The width of each bin is returned in binWidth.
+double FrequencyMeter::spectralPeak(const Waveform& waveform, double* binWidth) {
+    int size = waveform.size();
+    if (size < 4 || waveform.timeStep() <= 0.0)
+        return 0.0;
+
+    // The time axis is in milliseconds.
+    *binWidth = 1000.0 / (size * waveform.timeStep());
+
+    if (window_.size() != size) {
+        window_.resize(size);
+        for (int i = 0; i < size; i++) {
+            window_[i] = 0.5 - 0.5 * qCos(2.0 * M_PI * i / size);
+        }
+    }
+
+    const float* y = waveform.constData();
+    double mean = 0.0;
+    for (int i = 0; i < size; i++) {
+        mean += y[i];
+    }
+    mean /= size;
+
+    const FftPlan* transform = FftPlanCache::local()->plan(size);
+    const double* w = window_.constData();
+
+    for (int i = 0; i < size; i++) {
+        transform->input[i] = (y[i] - mean) * w[i];
+    }
+
+    fftw_execute(transform->plan);
+
+    const fftw_complex* spectrum = transform->spectrum;
+    int bins = size / 2 + 1;
+    int peak = 0;
+    double peakPower = 0.0;
+
+    for (int k = 1; k < bins; k++) {
+        double power = spectrum[k][0] * spectrum[k][0] + spectrum[k][1] * spectrum[k][1];
+        if (power > peakPower) {
+            peakPower = power;
+            peak = k;
+        }
+    }
+
+    if (peak == 0)
+        return 0.0;
+
+    double offset = 0.0;
+
+    if (peak < bins - 1) {
+        double below = spectrum[peak - 1][0] * spectrum[peak - 1][0]
+                + spectrum[peak - 1][1] * spectrum[peak - 1][1];
+        double above = spectrum[peak + 1][0] * spectrum[peak + 1][0]
+                + spectrum[peak + 1][1] * spectrum[peak + 1][1];
+
+        if (below > 0.0 && above > 0.0) {
+            double a = log(below), b = log(peakPower), c = log(above);
+            double curvature = a - 2.0 * b + c;
+
+            if (curvature < 0.0)
+                offset = qBound(-0.5, 0.5 * (a - c) / curvature, 0.5);
+        }
+    }
+
+    return (peak + offset) * *binWidth;
+}
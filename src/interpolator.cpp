@@ -0,0 +1,78 @@
+#include "interpolator.h"
+
+Interpolator::Interpolator()
+{
+    ratio_ = 0;
+}
+
+// Sets the interpolation ratio, the filter is only designed again when the
+// ratio changes.
+void Interpolator::setRatio(int ratio) {
+    ratio = qMax(1, ratio);
+
+    if (ratio != ratio_) {
+        ratio_ = ratio;
+        design();
+    }
+}
+
+// Returns the interpolation ratio.
+int Interpolator::ratio() const {
+    return ratio_;
+}
+
+// Designs the lowpass filter at the output rate and splits it into phases.
+// Tap k of the prototype is centred on half the taps of each phase, and tap
+// j of phase p is tap j * ratio + p of the prototype. The taps of each phase
+// are stored in reverse order so each output sample is a dot product with a
+// contiguous window of the input.
+void Interpolator::design() {
+    const int taps = INTERPOLATOR_TAPS_PER_PHASE;
+    int length = taps * ratio_;
+    double centre = (taps / 2) * ratio_;
+
+    phases_.resize(length);
+
+    for (int p = 0; p < ratio_; p++) {
+        for (int j = 0; j < taps; j++) {
+            int k = j * ratio_ + p;
+            double x = (k - centre) / ratio_;
+            double sinc = (x == 0.0) ? 1.0 : qSin(M_PI * x) / (M_PI * x);
+            double w = 2.0 * M_PI * k / length;
+            double window = 0.42 - 0.5 * qCos(w) + 0.08 * qCos(2.0 * w);
+
+            phases_[p * taps + (taps - 1 - j)] = sinc * window;
+        }
+    }
+}
+
+// Interpolates count samples of input into count * ratio samples of output.
+// Samples beyond either end of the input are treated as zero.
+void Interpolator::process(const float* input, int count, double* output) {
+    if (ratio_ == 0) setRatio(1);
+
+    const int taps = INTERPOLATOR_TAPS_PER_PHASE;
+    int before = taps / 2 - 1;
+
+    // The window of the output after input sample n starts at n - before.
+    padded_.resize(count + taps - 1);
+    double* padded = padded_.data();
+
+    for (int i = 0; i < padded_.size(); i++) {
+        int n = i - before;
+        padded[i] = (n >= 0 && n < count) ? input[n] : 0.0;
+    }
+
+    const double* phases = phases_.constData();
+    int ratio = ratio_;
+
+    // Each input sample's outputs are independent, so the input is split
+    // across the thread pool.
+    parallelFor(count, [=](int begin, int end) {
+        for (int n = begin; n < end; n++) {
+            for (int p = 0; p < ratio; p++) {
+                output[n * ratio + p] = dotProduct(phases + p * taps, padded + n, taps);
+            }
+        }
+    }, qMax(1, PARALLEL_GRAIN / ratio));
+}
@@ -8,9 +8,15 @@ MainWindow::MainWindow(QWidget *parent) :
     ui(new Ui::MainWindow)
 {
     // Register types to be used in Signal/Slot relationships between threads.
-    qRegisterMetaType<State>();
-    qRegisterMetaType<QVector<QPointF>>();
+    qRegisterMetaType<StateSnapshot>();
+    qRegisterMetaType<Waveform>();
+    qRegisterMetaType<Measurements>();
 
+    // Choose between direct and FFT convolution for this machine.
+    FirFilter::measureCrossover();
+
+    // Reuse the FFT plans measured in previous sessions.
+    FftPlanCache::loadWisdom();
 
     if( IS_WINDOWS ) {
         QApplication::setStyle(QStyleFactory::create("Fusion"));
@@ -51,94 +57,81 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
-// Called when a new curve has been measured, to set the label text in the GUI.
-void MainWindow::newMeasurements(int channel, double vMax, double vMin,
-                                 double vPp, double avg, double stdDev) {
-    switch((Channel)channel) {
+// Returns a time in seconds as text, or "-" if it could not be measured.
+static QString timeText(double time) {
+    return (time >= 0.0) ? valueToUnits(time) + "s" : "-";
+}
+
+// Returns a percentage as text, or "-" if it could not be measured.
+static QString percentText(double percent) {
+    return (percent >= 0.0) ? QString::number(percent, 'f', 1) + "%" : "-";
+}
+
+// Returns the labels of the measurement panel of a channel, in the order
+// they are set by newMeasurements.
+QList<QLabel*> MainWindow::measurementLabels(Channel channel) const {
+    switch(channel) {
         case A:
-            ui->aMaxLabel->setText(valueToUnits(vMax) + "V");
-            ui->aMinLabel->setText(valueToUnits(vMin) + "V");
-            ui->aPpLabel->setText(valueToUnits(vPp) + "V");
-            ui->aAvgLabel->setText(valueToUnits(avg) + "V");
-            ui->aStdDevLabel->setText(QString::number(stdDev));
-            break;
+            return {ui->aMaxLabel, ui->aMinLabel, ui->aPpLabel, ui->aAvgLabel,
+                    ui->aStdDevLabel, ui->aFreqLabel, ui->aPeriodLabel,
+                    ui->aDutyLabel, ui->aRmsLabel, ui->aCycleRmsLabel,
+                    ui->aRiseLabel, ui->aFallLabel, ui->aPosWidthLabel,
+                    ui->aNegWidthLabel, ui->aOvershootLabel, ui->aUndershootLabel};
         case B:
-            ui->bMaxLabel->setText(valueToUnits(vMax) + "V");
-            ui->bMinLabel->setText(valueToUnits(vMin) + "V");
-            ui->bPpLabel->setText(valueToUnits(vPp) + "V");
-            ui->bAvgLabel->setText(valueToUnits(avg) + "V");
-            ui->bStdDevLabel->setText(QString::number(stdDev));
-            break;
+            return {ui->bMaxLabel, ui->bMinLabel, ui->bPpLabel, ui->bAvgLabel,
+                    ui->bStdDevLabel, ui->bFreqLabel, ui->bPeriodLabel,
+                    ui->bDutyLabel, ui->bRmsLabel, ui->bCycleRmsLabel,
+                    ui->bRiseLabel, ui->bFallLabel, ui->bPosWidthLabel,
+                    ui->bNegWidthLabel, ui->bOvershootLabel, ui->bUndershootLabel};
         case F:
-            ui->fMaxLabel->setText(valueToUnits(vMax) + "V");
-            ui->fMinLabel->setText(valueToUnits(vMin) + "V");
-            ui->fPpLabel->setText(valueToUnits(vPp) + "V");
-            ui->fAvgLabel->setText(valueToUnits(avg) + "V");
-            ui->fStdDevLabel->setText(QString::number(stdDev));
-            break;
+            return {ui->fMaxLabel, ui->fMinLabel, ui->fPpLabel, ui->fAvgLabel,
+                    ui->fStdDevLabel, ui->fFreqLabel, ui->fPeriodLabel,
+                    ui->fDutyLabel, ui->fRmsLabel, ui->fCycleRmsLabel,
+                    ui->fRiseLabel, ui->fFallLabel, ui->fPosWidthLabel,
+                    ui->fNegWidthLabel, ui->fOvershootLabel, ui->fUndershootLabel};
         case M:
-            ui->mMaxLabel->setText(valueToUnits(vMax) + "V");
-            ui->mMinLabel->setText(valueToUnits(vMin) + "V");
-            ui->mPpLabel->setText(valueToUnits(vPp) + "V");
-            ui->mAvgLabel->setText(valueToUnits(avg) + "V");
-            ui->mStdDevLabel->setText(QString::number(stdDev));
-            break;
+            return {ui->mMaxLabel, ui->mMinLabel, ui->mPpLabel, ui->mAvgLabel,
+                    ui->mStdDevLabel, ui->mFreqLabel, ui->mPeriodLabel,
+                    ui->mDutyLabel, ui->mRmsLabel, ui->mCycleRmsLabel,
+                    ui->mRiseLabel, ui->mFallLabel, ui->mPosWidthLabel,
+                    ui->mNegWidthLabel, ui->mOvershootLabel, ui->mUndershootLabel};
     }
+
+    return QList<QLabel*>();
 }
 
-// Called when a new frequency has been calculated to display in the GUI.
-void MainWindow::newFrequency(int channel, double freq) {
-    switch((Channel)channel) {
-        case A:
-            ui->aFreqLabel->setText(valueToUnits(freq) + "Hz");
-            break;
-        case B:
-            ui->bFreqLabel->setText(valueToUnits(freq) + "Hz");
-            break;
-        case F:
-            ui->fFreqLabel->setText(valueToUnits(freq) + "Hz");
-            break;
-        case M:
-            ui->mFreqLabel->setText(valueToUnits(freq) + "Hz");
-            break;
+// Called when a new curve has been measured, to set the label text in the GUI.
+// The maximum and minimum are marked if samples were clipped by the ADC.
+void MainWindow::newMeasurements(int channel, Measurements measurements) {
+    QStringList text;
+    text << (measurements.clippedHigh > 0 ? ">" : "") + valueToUnits(measurements.max) + "V"
+         << (measurements.clippedLow > 0 ? "<" : "") + valueToUnits(measurements.min) + "V"
+         << valueToUnits(measurements.peakToPeak) + "V"
+         << valueToUnits(measurements.mean) + "V"
+         << QString::number(measurements.stdDev)
+         << valueToUnits(measurements.frequency) + "Hz"
+         << ((measurements.period > 0.0) ? valueToUnits(measurements.period) + "s" : "-")
+         << percentText(measurements.dutyCycle * 100.0)
+         << valueToUnits(measurements.rms) + "V"
+         << ((measurements.cycleRms >= 0.0) ? valueToUnits(measurements.cycleRms) + "V" : "-")
+         << timeText(measurements.riseTime)
+         << timeText(measurements.fallTime)
+         << timeText(measurements.positiveWidth)
+         << timeText(measurements.negativeWidth)
+         << percentText(measurements.overshoot)
+         << percentText(measurements.undershoot);
+
+    QList<QLabel*> labels = measurementLabels((Channel)channel);
+
+    for (int i = 0; i < labels.size(); i++) {
+        labels.at(i)->setText(text.at(i));
     }
 }
 
 // Called when a channel is hidden to change the labels in the GUI.
 void MainWindow::channelHidden(int channel) {
-    switch((Channel)channel) {
-        case A:
-            ui->aMaxLabel->setText("-");
-            ui->aMinLabel->setText("-");
-            ui->aPpLabel->setText("-");
-            ui->aAvgLabel->setText("-");
-            ui->aStdDevLabel->setText("-");
-            ui->aFreqLabel->setText("-");
-            break;
-        case B:
-            ui->bMaxLabel->setText("-");
-            ui->bMinLabel->setText("-");
-            ui->bPpLabel->setText("-");
-            ui->bAvgLabel->setText("-");
-            ui->bStdDevLabel->setText("-");
-            ui->bFreqLabel->setText("-");
-            break;
-        case F:
-            ui->fMaxLabel->setText("-");
-            ui->fMinLabel->setText("-");
-            ui->fPpLabel->setText("-");
-            ui->fAvgLabel->setText("-");
-            ui->fStdDevLabel->setText("-");
-            ui->fFreqLabel->setText("-");
-            break;
-        case M:
-            ui->mMaxLabel->setText("-");
-            ui->mMinLabel->setText("-");
-            ui->mPpLabel->setText("-");
-            ui->mAvgLabel->setText("-");
-            ui->mStdDevLabel->setText("-");
-            ui->mFreqLabel->setText("-");
-            break;
+    foreach (QLabel* label, measurementLabels((Channel)channel)) {
+        label->setText("-");
     }
 }
 
@@ -179,6 +172,34 @@ void MainWindow::generateOscilloscopeToolbar() {
     sampleRateLabel_ = new QLabel("Sample Rate: " + valueToUnits(sampleRate) + "Sps");
     sampleRateLabel_->setStyleSheet("QLabel { color: #3c3c3c;}");
 
+    spectrumSelect_ = new QCheckBox("Spectrum");
+    spectrumSelect_->setChecked(state_->spectrumEnabled());
+
+    QLabel* spectrumWindowLabel = new QLabel(" Window: ");
+    spectrumWindowLabel->setStyleSheet("QLabel { color: #3c3c3c;}");
+
+    spectrumWindowSelect_ = new QComboBox();
+    spectrumWindowSelect_->addItem("Hann");
+    spectrumWindowSelect_->addItem("Blackman");
+    spectrumWindowSelect_->addItem("Flat top");
+
+    QLabel* spectrumAveragesLabel = new QLabel(" Averages: ");
+    spectrumAveragesLabel->setStyleSheet("QLabel { color: #3c3c3c;}");
+
+    spectrumAveragesSelect_ = new QSpinBox();
+    spectrumAveragesSelect_->setMinimum(1);
+    spectrumAveragesSelect_->setMaximum(64);
+    spectrumAveragesSelect_->setValue(state_->getSpectrumAverages());
+
+    QLabel* bandpassRateLabel = new QLabel("Band-pass rate: ");
+    bandpassRateLabel->setStyleSheet("QLabel { color: #3c3c3c;}");
+
+    bandpassRateSelect_ = new QComboBox();
+    foreach (double rate, bandpassRates) {
+        bandpassRateSelect_->addItem(valueToUnits(rate) + "Sps");
+    }
+    bandpassRateSelect_->setCurrentIndex(state_->getBandpassRate());
+
     deviceStatus_ = new QLabel();
     deviceStatus_->setText("DISCONNECTED");
     deviceStatus_->setStyleSheet("QLabel { "
@@ -206,6 +227,15 @@ void MainWindow::generateOscilloscopeToolbar() {
     ui->oscilloscopeToolBar->addWidget(bitModeSelect_);
     ui->oscilloscopeToolBar->addSeparator();
     ui->oscilloscopeToolBar->addWidget(sampleRateLabel_);
+    ui->oscilloscopeToolBar->addSeparator();
+    ui->oscilloscopeToolBar->addWidget(spectrumSelect_);
+    ui->oscilloscopeToolBar->addWidget(spectrumWindowLabel);
+    ui->oscilloscopeToolBar->addWidget(spectrumWindowSelect_);
+    ui->oscilloscopeToolBar->addWidget(spectrumAveragesLabel);
+    ui->oscilloscopeToolBar->addWidget(spectrumAveragesSelect_);
+    ui->oscilloscopeToolBar->addSeparator();
+    ui->oscilloscopeToolBar->addWidget(bandpassRateLabel);
+    ui->oscilloscopeToolBar->addWidget(bandpassRateSelect_);
     ui->oscilloscopeToolBar->addWidget(spacer2);
     ui->oscilloscopeToolBar->addWidget(deviceStatus_);
     ui->oscilloscopeToolBar->addWidget(spacer3);
@@ -224,15 +254,16 @@ void MainWindow::createPlot() {
 
     QObject::connect(plot_, &Plot::error, this, &MainWindow::catchError);
     QObject::connect(plot_, &Plot::newMeasurements, this, &MainWindow::newMeasurements);
-    QObject::connect(plot_, &Plot::newFrequency, this, &MainWindow::newFrequency);
     QObject::connect(plot_, &Plot::channelHidden, this, &MainWindow::channelHidden);
 
     QFrame *legend = new QFrame();
 
     QwtPlot* markerPlot = new QwtPlot();
+    QwtPlot* spectrumPlot = new QwtPlot();
 
     plot_->setLegend(legend);
     plot_->setMarkerPlot(markerPlot);
+    plot_->setSpectrumPlot(spectrumPlot);
 
     QString style = "QLabel {color: white;}";
 
@@ -256,14 +287,17 @@ void MainWindow::createPlot() {
     windowLayout->addWidget(plot_, 1, 1, 1, 5);
     windowLayout->addWidget(markerPlot, 1, 0, 1, 1);
 
-    windowLayout->addWidget(filterLabel, 2, 1, 1, 1);
-    windowLayout->addWidget(filterInfo_, 2, 2, 1, 2);
-    windowLayout->addWidget(mathLabel, 2, 4, 1, 1);
-    windowLayout->addWidget(equationInfo_, 2, 5, 1, 1);
-    windowLayout->addWidget(functionLabel, 3, 1, 1, 2);
-    windowLayout->addWidget(functionGenInfo_, 3, 3, 1, 3);
+    windowLayout->addWidget(spectrumPlot, 2, 1, 1, 5);
 
-    windowLayout->setRowStretch(1, 1);
+    windowLayout->addWidget(filterLabel, 3, 1, 1, 1);
+    windowLayout->addWidget(filterInfo_, 3, 2, 1, 2);
+    windowLayout->addWidget(mathLabel, 3, 4, 1, 1);
+    windowLayout->addWidget(equationInfo_, 3, 5, 1, 1);
+    windowLayout->addWidget(functionLabel, 4, 1, 1, 2);
+    windowLayout->addWidget(functionGenInfo_, 4, 3, 1, 3);
+
+    windowLayout->setRowStretch(1, 2);
+    windowLayout->setRowStretch(2, 1);
     windowLayout->setColumnStretch(2, 1);
     windowLayout->setColumnStretch(3, 1);
     windowLayout->setColumnStretch(4, 1);
@@ -284,6 +318,14 @@ void MainWindow::connectDials() {
     connect(comHandler_, &CommunicationHandler::numSamplesChanged, this, &MainWindow::numSamplesChanged);
     connect(noSamplesSelect_, &QSpinBox::editingFinished, this, &MainWindow::numSamplesReady);
 
+    // Signals to handle spectrum analyser option changes.
+    connect(spectrumSelect_, &QCheckBox::toggled, plot_, &Plot::setSpectrumEnabled);
+    connect(spectrumWindowSelect_, SIGNAL(currentIndexChanged(int)), plot_, SLOT(setSpectrumWindow(int)));
+    connect(spectrumAveragesSelect_, SIGNAL(valueChanged(int)), plot_, SLOT(setSpectrumAverages(int)));
+
+    // Signal to handle changes of the band-pass output rate.
+    connect(bandpassRateSelect_, SIGNAL(currentIndexChanged(int)), plot_, SLOT(setBandpassRate(int)));
+
     // Signals to handle a bit mode change.
     connect(comHandler_, &CommunicationHandler::bitModeChanged, this, &MainWindow::bitModeChanged);
     connect(bitModeSelect_, SIGNAL(currentIndexChanged(int)), comHandler_, SLOT(setBitMode(int)));
@@ -856,18 +898,26 @@ void MainWindow::loadFilter(QString fileName) {
             return;
         }
 
+        BiquadCascade sections;
+
         if (aVals.size() == 0) {
             state_->setFilterType(FIR);
             type = "FIR";
         } else {
             state_->setFilterType(IIR);
             type = "IIR";
+
+            // Factor the filter once here rather than on every frame. If it
+            // can not be factored it is applied in direct form.
+            if (!sections.design(bVals, aVals))
+                qDebug() << "IIR filter could not be factored into second order sections.";
         }
 
         filterInfo_->setText(type + " filter applied to " + channelName);
         state_->setFilterChannel(channel);
         state_->setATaps(aVals);
         state_->setBTaps(bVals);
+        state_->setSections(sections);
         state_->setFilterEnabled(true);
         plot_->calculateFilter();
     }
@@ -891,9 +941,10 @@ void MainWindow::about() {
 }
 
 // Called when the application is about to close, handles correct shut
-// down of the TCP socket and the channel threads.
+// down of the TCP socket and the channel processing.
 void MainWindow::closeEvent(QCloseEvent *event) {
     comHandler_->closeConnection();
     plot_->exit();
+    FftPlanCache::saveWisdom();
     event->accept();
 }
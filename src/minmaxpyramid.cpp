@@ -0,0 +1,200 @@
+#include "minmaxpyramid.h"
+
+#include <qmath.h>
+
+MinMaxPyramid::MinMaxPyramid()
+{
+
+}
+
+// Builds the pyramid for a waveform. The waveform's samples are shared
+// rather than copied.
+void MinMaxPyramid::build(const Waveform& waveform) {
+    clear();
+    base_ = waveform;
+    reduceLevels();
+}
+
+// Removes all samples and levels from the pyramid.
+void MinMaxPyramid::clear() {
+    base_ = Waveform();
+    min_.clear();
+    max_.clear();
+}
+
+// Returns true if the pyramid contains no samples.
+bool MinMaxPyramid::isEmpty() const {
+    return base_.isEmpty();
+}
+
+// Returns the number of reduced levels stored above the samples.
+int MinMaxPyramid::levels() const {
+    return min_.size();
+}
+
+// Returns the number of samples that fall within each pixel for the given
+// horizontal scale.
+double MinMaxPyramid::samplesPerPixel(const QwtScaleMap& xMap) const {
+    double pixels = qAbs(xMap.p2() - xMap.p1());
+
+    if (pixels <= 0.0 || base_.timeStep() <= 0.0)
+        return 0.0;
+
+    return qAbs(xMap.s2() - xMap.s1()) / base_.timeStep() / pixels;
+}
+
+// Returns the level whose block size best matches a pixel at the given
+// horizontal scale, where level 0 is the samples themselves and level k
+// holds blocks of 2^k samples.
+int MinMaxPyramid::levelFor(const QwtScaleMap& xMap) const {
+    double samples = samplesPerPixel(xMap);
+
+    if (samples < 2.0)
+        return 0;
+
+    int level = qFloor(log2(samples));
+
+    if (level < PYRAMID_BASE_LEVEL)
+        return 0;
+
+    return qMin(level, PYRAMID_BASE_LEVEL + levels() - 1);
+}
+
+// Returns the envelope of the waveform with one column per pixel across the
+// interval of the given horizontal scale.
+Envelope MinMaxPyramid::envelope(const QwtScaleMap& xMap) const {
+    Envelope envelope;
+    int columns = qRound(qAbs(xMap.p2() - xMap.p1()));
+
+    if (columns <= 0 || base_.isEmpty() || base_.timeStep() <= 0.0)
+        return envelope;
+
+    envelope.startTime = xMap.s1();
+    envelope.endTime = xMap.s2();
+    envelope.min.resize(columns);
+    envelope.max.resize(columns);
+
+    int size = base_.size();
+    double columnWidth = (envelope.endTime - envelope.startTime) / columns;
+    double samplesPerColumn = columnWidth / base_.timeStep();
+    double firstSample = (envelope.startTime - base_.startTime()) / base_.timeStep();
+    int first = qBound(0, qCeil(firstSample), size);
+
+    for (int c = 0; c < columns; c++) {
+        int last = qBound(first, qCeil(firstSample + (c + 1) * samplesPerColumn), size);
+
+        float minY = 1.0f, maxY = -1.0f;
+
+        if (last > first)
+            rangeMinMax(first, last, &minY, &maxY);
+
+        envelope.min[c] = minY;
+        envelope.max[c] = maxY;
+        first = last;
+    }
+
+    return envelope;
+}
+
+// Reduces each complete block of the waveform into the levels above it.
+void MinMaxPyramid::reduceLevels() {
+    const float* y = base_.constData();
+    int size = base_.size();
+
+    for (int k = PYRAMID_BASE_LEVEL; (size >> k) > 0; k++) {
+        int level = k - PYRAMID_BASE_LEVEL;
+
+        if (min_.size() <= level) {
+            min_.append(QVector<float>());
+            max_.append(QVector<float>());
+        }
+
+        QVector<float>& levelMin = min_[level];
+        QVector<float>& levelMax = max_[level];
+        int complete = size >> k;
+
+        levelMin.resize(complete);
+        levelMax.resize(complete);
+
+        if (level == 0) {
+            int blockSize = 1 << PYRAMID_BASE_LEVEL;
+
+            for (int i = 0; i < complete; i++) {
+                const float* block = y + i * blockSize;
+                float minY = block[0], maxY = block[0];
+
+                for (int j = 1; j < blockSize; j++) {
+                    minY = qMin(minY, block[j]);
+                    maxY = qMax(maxY, block[j]);
+                }
+
+                levelMin[i] = minY;
+                levelMax[i] = maxY;
+            }
+        } else {
+            const float* belowMin = min_.at(level - 1).constData();
+            const float* belowMax = max_.at(level - 1).constData();
+
+            for (int i = 0; i < complete; i++) {
+                levelMin[i] = qMin(belowMin[2 * i], belowMin[2 * i + 1]);
+                levelMax[i] = qMax(belowMax[2 * i], belowMax[2 * i + 1]);
+            }
+        }
+    }
+}
+
+// Finds the minimum and maximum of the samples in [first, last). Partial
+// blocks at either end are taken from the level below, so each level
+// contributes at most two blocks.
+void MinMaxPyramid::rangeMinMax(int first, int last, float* minY, float* maxY) const {
+    const float* y = base_.constData();
+    float lo = y[first], hi = y[first];
+    int blockSize = 1 << PYRAMID_BASE_LEVEL;
+
+    int alignedFirst = qMin(last, (first + blockSize - 1) & ~(blockSize - 1));
+    int alignedLast = qMax(alignedFirst, last & ~(blockSize - 1));
+
+    for (int i = first; i < alignedFirst; i++) {
+        lo = qMin(lo, y[i]);
+        hi = qMax(hi, y[i]);
+    }
+
+    for (int i = alignedLast; i < last; i++) {
+        lo = qMin(lo, y[i]);
+        hi = qMax(hi, y[i]);
+    }
+
+    first = alignedFirst >> PYRAMID_BASE_LEVEL;
+    last = alignedLast >> PYRAMID_BASE_LEVEL;
+
+    for (int level = 0; first < last; level++) {
+        const float* levelMin = min_.at(level).constData();
+        const float* levelMax = max_.at(level).constData();
+
+        if (level == levels() - 1) {
+            for (int i = first; i < last; i++) {
+                lo = qMin(lo, levelMin[i]);
+                hi = qMax(hi, levelMax[i]);
+            }
+            break;
+        }
+
+        if (first & 1) {
+            lo = qMin(lo, levelMin[first]);
+            hi = qMax(hi, levelMax[first]);
+            first++;
+        }
+
+        if (last & 1) {
+            last--;
+            lo = qMin(lo, levelMin[last]);
+            hi = qMax(hi, levelMax[last]);
+        }
+
+        first >>= 1;
+        last >>= 1;
+    }
+
+    *minY = lo;
+    *maxY = hi;
+}
@@ -0,0 +1,28 @@
+#include "parallel.h"
+
+#include <QVector>
+#include <QPair>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+// Splits the range into at most one chunk per pool thread, each at least
+// grain iterations long.
+void parallelFor(int count, const std::function<void(int, int)>& body, int grain) {
+    int threads = QThreadPool::globalInstance()->maxThreadCount();
+    int chunks = qBound(1, count / qMax(1, grain), qMax(1, threads));
+
+    if (chunks == 1) {
+        body(0, count);
+        return;
+    }
+
+    QVector<QPair<int, int> > ranges(chunks);
+    for (int i = 0; i < chunks; i++) {
+        ranges[i] = qMakePair((int)((qint64)count * i / chunks),
+                              (int)((qint64)count * (i + 1) / chunks));
+    }
+
+    QtConcurrent::blockingMap(ranges, [&body](QPair<int, int>& range) {
+        body(range.first, range.second);
+    });
+}
@@ -8,17 +8,36 @@
  * Term -> Base {(TIMES|DIVIDE) Base}
  * Base -> Unary [POWER Unary]
  * Unary -> [MINUS] Factor
- * Factor -> LPAREN Expression RPAREN | number
+ * Factor -> LPAREN Expression RPAREN | Function | Channel | Constant | number
+ * Function -> NAME LPAREN Expression [COMMA number] RPAREN
+ * Channel -> A | B | F
+ * Constant -> pi | e
+ *
+ * NAME is one of abs, sqrt, log, sin, diff, integ, avg and fft, only avg
+ * takes the second argument.
+ *
+ * The equation is parsed once into an expression tree, which is compiled
+ * to bytecode and run over every sample of the plots.
  */
 Parser::Parser()
 {
-
+    status_ = ERROR;
+    currentToken_ = 0;
+    resultPlot_ = NULL;
+    requiresA_ = false;
+    requiresB_ = false;
+    requiresF_ = false;
 }
 
 // Checks the symbols of the equation and returns OK if the
-// equation is valid.
+// equation is valid. The equation is compiled once, checking the same
+// equation again returns the previous result.
 Error Parser::checkSymbols(QString exp) {
-    qDebug() << "Parser::checkSymbols";
+    if (exp == expression_ && status_ == OK)
+        return OK;
+
+    expression_ = exp;
+    status_ = ERROR;
     tokens_.clear();
     //resultPlot_->clear();
     error_ = "";
@@ -34,6 +53,27 @@ Error Parser::checkSymbols(QString exp) {
         if (c.isSpace())
             continue;
 
+        if (c.isLower()) {
+            // Names of constants and functions.
+            if (currentToken != "") {
+                tokens_.append(currentToken);
+                currentToken = "";
+            }
+
+            QString name = "";
+            while (i < exp.length() && exp.at(i).isLower())
+                name += exp.at(i++);
+            i--;
+
+            if (!validNames.contains(name)) {
+                error_ = "invalid symbol " + name;
+                return ERROR;
+            }
+
+            tokens_.append(name);
+            continue;
+        }
+
         if (!c.isDigit() && !validSymbols.contains(c)) {
             error_ = "invalid symbol " + QString(c);
             return ERROR;
@@ -57,22 +97,6 @@ Error Parser::checkSymbols(QString exp) {
         if (c == '.' || c.isDigit()) {
             currentToken += c;
 
-        } else if (c == 'p') {
-            if (currentToken != "") {
-                tokens_.append(QString(currentToken));
-                currentToken = "";
-            }
-
-            i++;
-
-            if (i == exp.length() || exp.at(i) != 'i') {
-                error_ = "character " + QString::number(i) + "is not a valid symbol.";
-                return ERROR;
-            }
-
-
-            tokens_.append("pi");
-
         } else {
 
             if (currentToken != "") {
@@ -92,102 +116,244 @@ Error Parser::checkSymbols(QString exp) {
         error_ = "missing closing bracket.";
         return ERROR;
     }
-    qDebug() << "Finished";
-    return OK;
+
+    status_ = compile();
+    return status_;
 }
 
-// Parses the curve for all the points on the provided curves.
-Error Parser::parse(QVector<QPointF> a, QVector<QPointF> b,
-                    QVector<QPointF> f, quint16 noSamples,
-                    double timeDiv, QVector<QPointF> *result) {
-    qDebug() << "Parser::parse";
-    Error error;
-    error_ = "";
-    plotA_ = a;
-    plotB_ = b;
-    plotF_ = f;
-    currentAVal_ = 0;
-    currentBVal_ = 0;
-    currentFVal_ = 0;
-    //resultPlot_->clear();
-    resultPlot_ = result;
+// Parses the tokens into an expression tree, optimises it and compiles it
+// to bytecode. Nodes are added after their operands, so each node is given
+// the register of its own index.
+Error Parser::compile() {
+    nodes_.clear();
+    bytecode_.clear();
+    currentToken_ = 0;
 
-    if ((requiresA_ && plotA_.isEmpty())
-            || (requiresB_ && plotB_.isEmpty())
-            || (requiresF_ && plotF_.isEmpty()) ) {
-        error_ = "cannot use values of a plot with no data.";
+    int root = parseExp();
+    if (root < 0 || currentToken_ < 0 || currentToken_ != tokens_.count()) {
+        if (error_ == "")
+            error_ = "because it can't.";
         return ERROR;
     }
 
-    int actualSamples;
+    QVector<ExpNode> optimised;
+    QVector<int> mapped(nodes_.size(), -1);
+    root = optimise(root, optimised, mapped);
+
+    // Operands that were folded or simplified away are left unused, only the
+    // nodes the result depends on are kept.
+    QVector<bool> live(optimised.size(), false);
+    QVector<int> renumbered(optimised.size(), -1);
+    live[root] = true;
+
+    for (int i = optimised.size() - 1; i >= 0; i--) {
+        const ExpNode& node = optimised.at(i);
+        if (!live.at(i) || node.type != OP) continue;
+        live[node.left] = true;
+        if (node.right >= 0) live[node.right] = true;
+    }
 
-    if (requiresA_ && plotA_.size() < (timeDiv * 200000) && plotA_.size() < 10000000) {
-        actualSamples = plotA_.size();
-    } else if (requiresB_) {
-        actualSamples = plotB_.size();
-    } else if (requiresF_) {
-        actualSamples = plotF_.size();
-    } else {
-        actualSamples = noSamples;
+    nodes_.clear();
+    for (int i = 0; i < optimised.size(); i++) {
+        if (!live.at(i)) continue;
+        ExpNode node = optimised.at(i);
+        if (node.left >= 0) node.left = renumbered.at(node.left);
+        if (node.right >= 0) node.right = renumbered.at(node.right);
+        renumbered[i] = nodes_.size();
+        nodes_.append(node);
     }
 
-    int sampleDiff = noSamples - actualSamples;
+    root = renumbered.at(root);
+
+    for (int i = 0; i < nodes_.size(); i++) {
+        const ExpNode& node = nodes_.at(i);
+        Instruction instruction = {LOAD_CONST, i, node.left, node.right, node.value};
+
+        if (node.type == VAR) {
+            instruction.code = (node.channel == A) ? LOAD_A
+                             : (node.channel == B) ? LOAD_B : LOAD_F;
+        } else if (node.type == OP) {
+            switch (node.op) {
+                case PLUS: instruction.code = ADD; break;
+                case MINUS: instruction.code = SUB; break;
+                case TIMES: instruction.code = MUL; break;
+                case DIVIDE: instruction.code = DIV; break;
+                case EXP: instruction.code = POW; break;
+                case NEGATE: instruction.code = NEG; break;
+                case ABS: instruction.code = CALL_ABS; break;
+                case SQRT: instruction.code = CALL_SQRT; break;
+                case LOG: instruction.code = CALL_LOG; break;
+                case SIN: instruction.code = CALL_SIN; break;
+                case DIFF: instruction.code = CALL_DIFF; break;
+                case INTEG: instruction.code = CALL_INTEG; break;
+                case AVG: instruction.code = CALL_AVG; break;
+                case FFT: instruction.code = CALL_FFT; break;
+            }
+        }
 
-    double currentTime = -5.0 * timeDiv;
-    double timeStep = 10.0 * timeDiv / ((double)noSamples - 1.0);
+        bytecode_.append(instruction);
+    }
 
-    currentTime += sampleDiff * timeStep;
+    bytecode_.setResult(root);
 
-    for (int i = 0; i < noSamples; i++) {
-        if (currentTime > 5.0 * timeDiv) break;
+#ifndef QT_NO_DEBUG
+    qDebug() << "Compiled " << expression_ << " to:";
+    QStringList listing = bytecode_.listing();
+    for (int i = 0; i < listing.size(); i++)
+        qDebug() << listing.at(i);
+#endif
 
-        if (requiresA_) {
-            if (i < plotA_.size() && plotA_.at(i).x() == currentTime) {
-                currentAVal_ = plotA_.at(i).y();
+    return OK;
+}
+
+// Returns the value of an operation on constant operands.
+static double fold(Op op, double left, double right) {
+    switch (op) {
+        case PLUS: return left + right;
+        case MINUS: return left - right;
+        case TIMES: return left * right;
+        case DIVIDE: return left / right;
+        case EXP: return qPow(left, right);
+        case NEGATE: return -left;
+        case ABS: return qAbs(left);
+        case SQRT: return qSqrt(left);
+        case LOG: return qLn(left);
+        case SIN: return qSin(left);
+        default: return 0.0;
+    }
+}
+
+// Copies the subexpression of the node at index into optimised, and returns
+// its index there. Operations on constants are folded into a constant,
+// x^2 becomes x*x, and adding 0 or multiplying by 1 is removed. Equal
+// subexpressions are only added once, so they are only evaluated once.
+// Mapped holds the optimised index of each node already copied.
+int Parser::optimise(int index, QVector<ExpNode>& optimised, QVector<int>& mapped) {
+    if (mapped.at(index) >= 0)
+        return mapped.at(index);
+
+    ExpNode node = nodes_.at(index);
+
+    if (node.type == OP) {
+        node.left = optimise(node.left, optimised, mapped);
+        if (node.right >= 0)
+            node.right = optimise(node.right, optimised, mapped);
+
+        const ExpNode left = optimised.at(node.left);
+        const ExpNode* right = (node.right >= 0) ? &optimised.at(node.right) : NULL;
+        bool elementwise = (node.op != DIFF && node.op != INTEG
+                            && node.op != AVG && node.op != FFT);
+        int simplified = -1;
+
+        if (elementwise && left.type == CONST && (!right || right->type == CONST)) {
+            node.value = fold(node.op, left.value, right ? right->value : 0.0);
+            node.type = CONST;
+            node.op = PLUS;
+            node.left = -1;
+            node.right = -1;
+        } else if (right && right->type == CONST) {
+            if (node.op == EXP && right->value == 2.0) {
+                node.op = TIMES;
+                node.right = node.left;
+            } else if ((node.op == EXP && right->value == 1.0)
+                       || ((node.op == PLUS || node.op == MINUS) && right->value == 0.0)
+                       || ((node.op == TIMES || node.op == DIVIDE) && right->value == 1.0)) {
+                simplified = node.left;
             }
-            else {
-                //qDebug() << "x: " << QString::number(plotA_.at(i).x(), 'f', 8) << " currentTime: " << QString::number(currentTime, 'f', 8);
-                currentAVal_ = approxVoltage(A, i, currentTime);
+        } else if (right && left.type == CONST) {
+            if ((node.op == PLUS && left.value == 0.0)
+                    || (node.op == TIMES && left.value == 1.0)) {
+                simplified = node.right;
             }
         }
-        if (requiresB_) {
-            if (i < plotB_.size() && plotB_.at(i).x() == currentTime)
-                currentBVal_ = plotB_.at(i).y();
-            else
-                currentBVal_ = approxVoltage(B, i, currentTime);
-        }
-        if (i < plotF_.size() && requiresF_) {
-            if (plotF_.at(i).x() == currentTime)
-                currentFVal_ = plotF_.at(i).y();
-            else
-                currentFVal_ = approxVoltage(F, i, currentTime);
+
+        if (simplified >= 0) {
+            mapped[index] = simplified;
+            return simplified;
         }
+    }
 
-        error = parse(currentTime);
-        if (error != OK) break;
-        currentTime += timeStep;
+    for (int i = 0; i < optimised.size(); i++) {
+        const ExpNode& other = optimised.at(i);
+        if (other.type == node.type && other.op == node.op && other.channel == node.channel
+                && other.value == node.value && other.left == node.left
+                && other.right == node.right) {
+            mapped[index] = i;
+            return i;
+        }
     }
 
-    return error;
+    optimised.append(node);
+    mapped[index] = optimised.size() - 1;
+    return mapped.at(index);
 }
 
-// Begins parsing the provided equation with 3 point values, then stores the
-// result in the vector of plot points.
-Error Parser::parse(double timeVal) {
-    currentToken_ = 0;
-    double result = parseExp();
-    if (currentToken_ < 0 || currentToken_ != tokens_.count()) {
-        if (error_ == "")
-            error_ = "because it can't.";
+// Adds a node to the expression tree and returns its index.
+int Parser::addNode(ExpType type, Op op, int left, int right, double value, Channel channel) {
+    ExpNode node = {type, op, channel, value, left, right};
+    nodes_.append(node);
+    return nodes_.size() - 1;
+}
+
+// Parses the curve for all the points on the provided curves. The inputs
+// are first aligned to the time of each output point, then the compiled
+// equation is run over the aligned inputs.
+Error Parser::parse(const Waveform& a, const Waveform& b,
+                    const Waveform& f, quint16 noSamples,
+                    double timeDiv, Waveform *result) {
+    error_ = "";
+    plotA_ = a;
+    plotB_ = b;
+    plotF_ = f;
+    resultPlot_ = result;
+
+    if (status_ != OK) {
+        error_ = "the equation has not been compiled.";
+        return ERROR;
+    }
+
+    if ((requiresA_ && plotA_.isEmpty())
+            || (requiresB_ && plotB_.isEmpty())
+            || (requiresF_ && plotF_.isEmpty()) ) {
+        error_ = "cannot use values of a plot with no data.";
         return ERROR;
     }
 
-    resultPlot_->append(QPointF(timeVal, result));
+    // The result starts at the first point of the screen's time grid where
+    // every input has data, so a partial acquisition is only calculated
+    // where it has been received. Inputs carry their own timing, so this
+    // holds for any sample rate, such as the decimated band-pass channel.
+    double startTime = -5.0 * timeDiv;
+    double timeStep = 10.0 * timeDiv / ((double)noSamples - 1.0);
+    double firstTime = startTime;
+
+    if (requiresA_) firstTime = qMax(firstTime, plotA_.startTime());
+    if (requiresB_) firstTime = qMax(firstTime, plotB_.startTime());
+    if (requiresF_) firstTime = qMax(firstTime, plotF_.startTime());
+
+    startTime += qCeil((firstTime - startTime) / timeStep - 1e-6) * timeStep;
+
+    // The result ends at the right edge of the screen.
+    int count = 0;
+    while (count < noSamples && startTime + count * timeStep <= 5.0 * timeDiv)
+        count++;
+
+    if (requiresA_) align(plotA_, startTime, timeStep, count, alignedA_, false);
+    if (requiresB_) align(plotB_, startTime, timeStep, count, alignedB_, false);
+    if (requiresF_) align(plotF_, startTime, timeStep, count, alignedF_, true);
+
+    resultPlot_->clear();
+    resultPlot_->setTiming(startTime, timeStep);
+    resultPlot_->resize(count);
+
+    bytecode_.run(alignedA_.constData(), alignedB_.constData(), alignedF_.constData(),
+                  resultPlot_->data(), count, timeStep / 1000.0);
+
     return OK;
 }
 
-// Getter function returns the vector of points to plot on the curve.
-QVector<QPointF> Parser::plotData() {
+// Getter function returns the waveform to plot on the curve.
+Waveform Parser::plotData() {
     return *resultPlot_;
 }
 
@@ -213,29 +379,24 @@ bool Parser::requiresF() {
 
 // Parses an expression of the form:
 // Expression -> Term {(PLUS|MINUS) Term}
-double Parser::parseExp() {
-
-    double result = 0.0;
+int Parser::parseExp() {
 
     if (currentToken_ == -1)
-        return result;
+        return -1;
 
-    result = parseTerm();
+    int result = parseTerm();
 
     while(currentToken_ >= 0 && currentToken_ < tokens_.count()
-          && QString("+-").contains(tokens_.at(currentToken_))) {
+          && (tokens_.at(currentToken_) == "+" || tokens_.at(currentToken_) == "-")) {
 
-        QString op = tokens_.at(currentToken_);
+        Op op = (tokens_.at(currentToken_) == "+") ? PLUS : MINUS;
         currentToken_++;
 
-        if (op == "+")
-            result += parseTerm();
-        else if (op == "-")
-            result -= parseTerm();
-        else {
-            error_ = tokens_.at(currentToken_) + " is incorrectly used.";
-            currentToken_ = -1;
-        }
+        int right = parseTerm();
+        if (currentToken_ == -1)
+            return -1;
+
+        result = addNode(OP, op, result, right);
     }
 
     return result;
@@ -243,31 +404,32 @@ double Parser::parseExp() {
 
 // Parses a term of the form:
 // Term -> Base {(TIMES|DIVIDE) Base}
-double Parser::parseTerm() {
-
-    double result = 0.0;
+int Parser::parseTerm() {
 
     if (currentToken_ == -1)
-        return result;
+        return -1;
 
-    result = parseBase();
+    int result = parseBase();
 
     while(currentToken_ >= 0 && currentToken_ < tokens_.count()
-          && QString("*/").contains(tokens_.at(currentToken_))) {
+          && (tokens_.at(currentToken_) == "*" || tokens_.at(currentToken_) == "/")) {
 
-        QString op = tokens_.at(currentToken_);
+        Op op = (tokens_.at(currentToken_) == "*") ? TIMES : DIVIDE;
 
         currentToken_++;
 
-        if (op == "*")
-            result *= parseBase();
-        else if (op == "/" && tokens_.at(currentToken_) != "0")
-            result /= parseBase();
-        else {
+        if (op == DIVIDE && currentToken_ < tokens_.count()
+                && tokens_.at(currentToken_) == "0") {
             error_ = tokens_.at(currentToken_) + " is incorrectly used.";
             currentToken_ = -1;
+            return -1;
         }
 
+        int right = parseBase();
+        if (currentToken_ == -1)
+            return -1;
+
+        result = addNode(OP, op, result, right);
     }
 
     return result;
@@ -275,21 +437,23 @@ double Parser::parseTerm() {
 
 // Parses a Base of the form:
 // Base -> Unary [POWER Unary]
-double Parser::parseBase() {
-
-    double result = 0.0;
+int Parser::parseBase() {
 
     if (currentToken_ == -1)
-        return result;
+        return -1;
 
-    result = parseUnary();
+    int result = parseUnary();
 
     if (currentToken_ >= 0 && currentToken_ < tokens_.count()
             && tokens_.at(currentToken_) == "^") {
 
         currentToken_++;
 
-        result = qPow(result, parseUnary());
+        int exponent = parseUnary();
+        if (currentToken_ == -1)
+            return -1;
+
+        result = addNode(OP, EXP, result, exponent);
     }
 
     return result;
@@ -297,29 +461,29 @@ double Parser::parseBase() {
 
 // Parses a Unary of the form:
 // Unary -> [MINUS] Factor
-double Parser::parseUnary() {
-
-    double result = 0.0;
+int Parser::parseUnary() {
 
     if (currentToken_ < 0)
-        return result;
+        return -1;
 
     if (currentToken_ < tokens_.count() && tokens_.at(currentToken_) == "-") {
         currentToken_++;
 
-        result = -1.00 * parseFactor();
-    } else {
-        result = parseFactor();
+        int operand = parseFactor();
+        if (currentToken_ == -1)
+            return -1;
+
+        return addNode(OP, NEGATE, operand, -1);
     }
 
-    return result;
+    return parseFactor();
 }
 
 // Parses a factor of the form:
-// Factor -> LPAREN Expression RPAREN | number
-double Parser::parseFactor() {
+// Factor -> LPAREN Expression RPAREN | Function | Channel | Constant | number
+int Parser::parseFactor() {
 
-    double result = 0.0;
+    int result = -1;
 
     if(currentToken_ == tokens_.count()) {
         error_ = "missing rvalue.";
@@ -327,32 +491,41 @@ double Parser::parseFactor() {
         return result;
     }
 
+    QString token = tokens_.at(currentToken_);
     bool isDouble = false;
-    double value = tokens_.at(currentToken_).toDouble(&isDouble);
+    double value = token.toDouble(&isDouble);
 
     if (isDouble)
-        result = value;
-    else if (tokens_.at(currentToken_) == "(") {
+        result = addNode(CONST, PLUS, -1, -1, value);
+    else if (token == "(") {
         currentToken_++;
         result = parseExp();
 
         if(currentToken_ == -1)
-            return result;
+            return -1;
+
+        if (currentToken_ == tokens_.count() || tokens_.at(currentToken_) != ")") {
+            error_ = "missing closing bracket.";
+            currentToken_ = -1;
+            return -1;
+        }
     }
-    else if (tokens_.at(currentToken_) == "A")
-        result = currentAVal_;
-    else if (tokens_.at(currentToken_) == "B")
-        result = currentBVal_;
-    else if (tokens_.at(currentToken_) == "F")
-        result = currentFVal_;
-    else if (tokens_.at(currentToken_) == "pi")
-        result = PI;
-    else if (tokens_.at(currentToken_) == "e")
-        result = E;
+    else if (token == "A")
+        result = addNode(VAR, PLUS, -1, -1, 0.0, A);
+    else if (token == "B")
+        result = addNode(VAR, PLUS, -1, -1, 0.0, B);
+    else if (token == "F")
+        result = addNode(VAR, PLUS, -1, -1, 0.0, F);
+    else if (token == "pi")
+        result = addNode(CONST, PLUS, -1, -1, PI);
+    else if (token == "e")
+        result = addNode(CONST, PLUS, -1, -1, E);
+    else if (validNames.contains(token))
+        return parseFunction();
     else {
-        error_ = tokens_.at(currentToken_) + " is incorrectly used.";
+        error_ = token + " is incorrectly used.";
         currentToken_ = -1;
-        return result;
+        return -1;
     }
 
     currentToken_++;
@@ -360,87 +533,100 @@ double Parser::parseFactor() {
     return result;
 }
 
-// Returns true if the provided time is within the start and end time of the
-// channel's plotted data.
-bool Parser::withinBounds(Channel channel, double time) {
-    bool withinBounds = true;
-    switch(channel) {
-        case A:
-            if (time < plotA_.at(0).x() || time > plotA_.at(plotA_.size() - 1).x()) {
-                withinBounds = false;
-            }
-            break;
-        case B:
-            if (time < plotB_.at(0).x() || time > plotB_.at(plotB_.size() - 1).x()) {
-                withinBounds = false;
-            }
-            break;
-        case F:
-            if (time < plotF_.at(0).x() || time > plotF_.at(plotF_.size() - 1).x()) {
-                withinBounds = false;
-            }
-            break;
-        case M:
-            break;
+// Parses a function call of the form:
+// Function -> NAME LPAREN Expression [COMMA number] RPAREN
+// Only avg takes a second argument, the number of samples averaged.
+int Parser::parseFunction() {
+
+    QString name = tokens_.at(currentToken_);
+    Op op = (name == "abs") ? ABS : (name == "sqrt") ? SQRT
+          : (name == "log") ? LOG : (name == "sin") ? SIN
+          : (name == "diff") ? DIFF : (name == "integ") ? INTEG
+          : (name == "avg") ? AVG : FFT;
+
+    currentToken_++;
+
+    if (currentToken_ == tokens_.count() || tokens_.at(currentToken_) != "(") {
+        error_ = name + " is missing its arguments.";
+        currentToken_ = -1;
+        return -1;
     }
-    return withinBounds;
+
+    currentToken_++;
+
+    int operand = parseExp();
+    if (currentToken_ == -1)
+        return -1;
+
+    double length = 0.0;
+
+    if (op == AVG) {
+        bool isNumber = false;
+
+        if (currentToken_ + 1 < tokens_.count() && tokens_.at(currentToken_) == ",")
+            length = tokens_.at(currentToken_ + 1).toDouble(&isNumber);
+
+        if (!isNumber || length < 1.0 || length != qRound(length)) {
+            error_ = "avg needs a whole number of samples.";
+            currentToken_ = -1;
+            return -1;
+        }
+
+        currentToken_ += 2;
+    }
+
+    if (currentToken_ == tokens_.count() || tokens_.at(currentToken_) != ")") {
+        error_ = "missing closing bracket.";
+        currentToken_ = -1;
+        return -1;
+    }
+
+    currentToken_++;
+
+    return addNode(OP, op, operand, -1, length);
 }
 
-// Given a channel, index and time, returns the voltage value on that curve
-// at the given time in the most efficient way possible. If withinBounds
-// returns false for this channel and time, approxVoltage returns 0;
-double Parser::approxVoltage(Channel channel, int index, double time) {
-    if (!withinBounds(channel, time)) return 0.0;
-    double voltage = 0.0;
-    switch(channel) {
-        case A:
-            if (index < plotA_.size() && plotA_.at(index).x() == time)
-                return plotA_.at(index).y();
-            for (int i = 0; i < plotA_.size(); i++) {
-                double timeVal = plotA_.at(i).x();
-                if (timeVal == time) {
-                    return plotA_.at(i).y();
-                } else if (timeVal > time) {
-                    double v1 = plotA_.at(i - 1).y();
-                    double v2 = plotA_.at(i).y();
-                    voltage = v1 + ((v2 - v1) * (time - plotA_.at(i - 1).x()) / (timeVal - plotA_.at(i - 1).x()));
-                    //qDebug() << voltage;
-                    break;
-                }
-            }
-            break;
-        case B:
-            if (index < plotB_.size() && plotB_.at(index).x() == time)
-                return plotB_.at(index).y();
-            for (int i = 0; i < plotB_.size(); i++) {
-                double timeVal = plotB_.at(i).x();
-                if (timeVal == time) {
-                    return plotB_.at(i).y();
-                } else if (timeVal > time) {
-                    double v1 = plotB_.at(i - 1).y();
-                    double v2 = plotB_.at(i).y();
-                    voltage = v1 + ((v2 - v1) * (time - plotB_.at(i - 1).x()) / (timeVal - plotB_.at(i - 1).x()));
-                    break;
-                }
-            }
-            break;
-        case F:
-            if (index < plotF_.size() && plotF_.at(index).x() == time)
-                return plotF_.at(index).y();
-            for (int i = 0; i < plotF_.size(); i++) {
-                double timeVal = plotF_.at(i).x();
-                if (timeVal == time) {
-                    return plotF_.at(i).y();
-                } else if (timeVal > time) {
-                    double v1 = plotF_.at(i - 1).y();
-                    double v2 = plotF_.at(i).y();
-                    voltage = v1 + ((v2 - v1) * (time - plotF_.at(i - 1).x()) / (timeVal - plotF_.at(i - 1).x()));
-                    break;
-                }
+// Resamples the plot onto count points of the time grid from startTime,
+// interpolating linearly between samples and giving 0 outside the plot.
+// The plot is uniformly sampled, so the sample before each point is found
+// directly from its time. If hold is set, points past the number of samples
+// in the plot repeat the last point before them.
+void Parser::align(const Waveform& plot, double startTime, double timeStep,
+                   int count, QVector<float>& aligned, bool hold) {
+    aligned.resize(count);
+
+    float* out = aligned.data();
+    const float* in = plot.constData();
+    int size = plot.size();
+    int resampled = hold ? qMin(count, size) : count;
+
+    if (plot.startTime() == startTime && plot.timeStep() == timeStep) {
+        // Already on the same grid.
+        int copied = qMin(resampled, size);
+        memcpy(out, in, copied * sizeof(float));
+        for (int i = copied; i < resampled; i++) out[i] = 0.0f;
+    } else {
+        double first = plot.startTime();
+        double last = plot.endTime();
+        double step = plot.timeStep();
+
+        for (int i = 0; i < resampled; i++) {
+            double time = startTime + i * timeStep;
+
+            if (size == 0 || time < first || time > last) {
+                out[i] = 0.0f;
+            } else if (size == 1 || step <= 0.0) {
+                out[i] = in[0];
+            } else {
+                double x = (time - first) / step;
+                int j = qMin((int)x, size - 2);
+                double v1 = in[j];
+                double v2 = in[j + 1];
+                out[i] = v1 + (v2 - v1) * (x - j);
             }
-            break;
-        case M:
-            break;
+        }
     }
-    return voltage;
+
+    float held = resampled > 0 ? out[resampled - 1] : 0.0f;
+    for (int i = resampled; i < count; i++) out[i] = held;
 }
@@ -1,5 +1,7 @@
 #include "plot.h"
 #include <QDebug>
+#include <QThreadPool>
+#include <QtConcurrent>
 
 QString valueToUnits(double value) {
     if (value == 0.0) {
@@ -69,41 +71,38 @@ Plot::Plot(State *state, QWidget *parent) : QwtPlot(parent)
     channelF_->setVisible(false);
     channelF_->attach(this);
 
-    aThread_ = new QThread(this);
-    channelA_->moveToThread(aThread_);
-    aThread_->start();
+    // Channels are processed on the shared thread pool, whose threads are
+    // kept alive so their FFT plans are not rebuilt.
+    QThreadPool::globalInstance()->setExpiryTimeout(-1);
 
-    bThread_ = new QThread(this);
-    channelB_->moveToThread(bThread_);
-    bThread_->start();
+    freqPlot_ = NULL;
 
-    fThread_ = new QThread(this);
-    channelF_->moveToThread(fThread_);
-    fThread_->start();
+    requested_.fill(0, 4);
+    plotted_.fill(0, 4);
+    inputsUsed_.fill(QVector<quint64>(4, 0), 4);
+    busy_.fill(false, 4);
+    invalidated_.fill(false, 4);
+    pending_.fill(StateSnapshot(), 4);
 
-    mThread_ = new QThread(this);
-    channelM_->moveToThread(mThread_);
-    mThread_->start();
-
-    QObject::connect(this, &Plot::processA, channelA_, &ChannelCurve::process);
     QObject::connect(channelA_, &ChannelCurve::plotReady, this, &Plot::plotReady);
     QObject::connect(channelA_, &ChannelCurve::measured, this, &Plot::newMeasurements);
-    QObject::connect(channelA_, &ChannelCurve::freqCalculated, this, &Plot::newFrequency);
+    QObject::connect(channelA_, &ChannelCurve::spectrumReady, this, &Plot::spectrumReady);
+    QObject::connect(channelA_, &ChannelCurve::finished, this, &Plot::finished);
 
-    QObject::connect(this, &Plot::processB, channelB_, &ChannelCurve::process);
     QObject::connect(channelB_, &ChannelCurve::plotReady, this, &Plot::plotReady);
     QObject::connect(channelB_, &ChannelCurve::measured, this, &Plot::newMeasurements);
-    QObject::connect(channelB_, &ChannelCurve::freqCalculated, this, &Plot::newFrequency);
+    QObject::connect(channelB_, &ChannelCurve::spectrumReady, this, &Plot::spectrumReady);
+    QObject::connect(channelB_, &ChannelCurve::finished, this, &Plot::finished);
 
-    QObject::connect(this, &Plot::processF, channelF_, &ChannelCurve::process);
     QObject::connect(channelF_, &ChannelCurve::plotReady, this, &Plot::plotReady);
     QObject::connect(channelF_, &ChannelCurve::measured, this, &Plot::newMeasurements);
-    QObject::connect(channelF_, &ChannelCurve::freqCalculated, this, &Plot::newFrequency);
+    QObject::connect(channelF_, &ChannelCurve::spectrumReady, this, &Plot::spectrumReady);
+    QObject::connect(channelF_, &ChannelCurve::finished, this, &Plot::finished);
 
-    QObject::connect(this, &Plot::processM, channelM_, &ChannelCurve::process);
     QObject::connect(channelM_, &ChannelCurve::plotReady, this, &Plot::plotReady);
     QObject::connect(channelM_, &ChannelCurve::measured, this, &Plot::newMeasurements);
-    QObject::connect(channelM_, &ChannelCurve::freqCalculated, this, &Plot::newFrequency);
+    QObject::connect(channelM_, &ChannelCurve::spectrumReady, this, &Plot::spectrumReady);
+    QObject::connect(channelM_, &ChannelCurve::finished, this, &Plot::finished);
     QObject::connect(channelM_, &ChannelCurve::error, this, &Plot::catchError);
 
     pickedVoltage_ = new QwtPlotMarker();
@@ -171,18 +170,23 @@ void Plot::pointDeselected() {
     replot();
 }
 
-void Plot::plotReady(int channel, QVector<QPointF> points) {
+// Called when a new frame of a channel has been calculated. Frames older than
+// the one shown are discarded, and the channels derived from this one are
+// calculated again.
+void Plot::plotReady(int channel, Waveform points, quint64 generation) {
+    if (generation < plotted_.at(channel))
+        return;
+
+    plotted_[channel] = generation;
     state_->setPlotPoints((Channel)channel, points);
 
     switch((Channel)channel) {
         case A:
-            state_->clearAcquisition(A);
             if (channelA_->selected()) {
                 selectClosePoint();
             }
             break;
         case B:
-            state_->clearAcquisition(B);
             if (channelB_->selected()) {
                 selectClosePoint();
             }
@@ -201,21 +205,195 @@ void Plot::plotReady(int channel, QVector<QPointF> points) {
 
     replot();
 
-    if (state_->getEquation().contains('A' + channel)) {
-        emit processM(*state_);
+    updateDerived();
+}
+
+// Called when a channel has finished with a frame, whether it was plotted,
+// dropped or could not be calculated. The latest frame requested while the
+// channel was busy is then processed, and a derived channel whose inputs
+// changed while it was busy is calculated again.
+void Plot::finished(int channel, quint64 generation) {
+    if (generation != requested_.at(channel))
+        return;
+
+    busy_[channel] = false;
+
+    if (!pending_.at(channel).isNull()) {
+        StateSnapshot frame = pending_.at(channel);
+        pending_[channel].clear();
+        process((Channel)channel, frame);
     }
 
-    if (!channelF_->isEmpty() && state_->getFilterChannel() == channel) {
-        emit processF(*state_);
+    updateDerived();
+}
+
+// Returns the curve of the given channel.
+ChannelCurve* Plot::curve(Channel channel) const {
+    switch (channel) {
+        case A: return channelA_;
+        case B: return channelB_;
+        case F: return channelF_;
+        default: return channelM_;
     }
+}
+
+// Returns the channels a derived channel is calculated from. The math
+// channel does not depend on the filter channel while the math channel is
+// being filtered.
+QList<Channel> Plot::inputs(Channel channel) const {
+    QList<Channel> channels;
+
+    if (channel == F) {
+        channels.append(state_->getFilterChannel());
+    } else if (channel == M) {
+        QString equation = state_->getEquation();
+        if (equation.contains('A')) channels.append(A);
+        if (equation.contains('B')) channels.append(B);
+        if (equation.contains('F') && state_->getFilterChannel() != M) channels.append(F);
+    }
+
+    return channels;
+}
 
+// Returns true if a derived channel is being calculated, once its equation
+// has been entered or its filter calculated.
+bool Plot::active(Channel channel) const {
+    if (channel == M)
+        return !state_->getEquation().isEmpty();
+
+    return invalidated_.at(F) || !channelF_->isEmpty();
+}
+
+// Requests a new frame of the channel with a snapshot of the current state.
+// The acquisition of a source channel is cleared once it is in the
+// snapshot, ready for the next capture. Each channel has at most one frame
+// in flight, a frame requested while it is busy is held until it finishes
+// and replaced by any newer one, so only the latest is processed.
+void Plot::request(Channel channel) {
+    StateSnapshot frame = snapshot();
+
+    if (channel == A || channel == B)
+        state_->clearAcquisition(channel);
+
+    if (busy_.at(channel))
+        pending_[channel] = frame;
+    else
+        process(channel, frame);
+}
+
+// Processes a frame of the channel on the shared thread pool.
+void Plot::process(Channel channel, StateSnapshot frame) {
+    busy_[channel] = true;
+    quint64 generation = ++requested_[channel];
+    curve(channel)->request(generation);
+
+    QtConcurrent::run(curve(channel), &ChannelCurve::process, frame, generation);
+}
+
+// Requests a new frame of each derived channel that was invalidated or whose
+// inputs have plotted a newer frame than it was last calculated from. The
+// channels are visited in the order they depend on each other, and a channel
+// waits while any derived channel it depends on is busy, so it is calculated
+// once from the new frames of all its inputs. A channel that is busy is not
+// queued again, it is requested once it has finished.
+void Plot::updateDerived() {
+    QList<Channel> order;
+
+    if (state_->getFilterChannel() == M)
+        order << M << F;
+    else
+        order << F << M;
+
+    foreach (Channel channel, order) {
+        if (!active(channel) || busy_.at(channel))
+            continue;
+
+        QList<Channel> channels = inputs(channel);
+        bool stale = invalidated_.at(channel);
+        bool waiting = false;
+
+        foreach (Channel input, channels) {
+            if (inputsUsed_.at(channel).at(input) != plotted_.at(input))
+                stale = true;
+            if ((input == F || input == M) && busy_.at(input))
+                waiting = true;
+        }
+
+        if (!stale || waiting)
+            continue;
+
+        foreach (Channel input, channels) {
+            inputsUsed_[channel][input] = plotted_.at(input);
+        }
+
+        invalidated_[channel] = false;
+        request(channel);
+    }
+}
+
+// Called when the spectrum of a channel has been calculated, the horizontal
+// axis spans the highest frequency of the channels shown.
+void Plot::spectrumReady(int channel, Waveform spectrum) {
+    if (freqPlot_ == NULL || !state_->spectrumEnabled())
+        return;
+
+    spectra_.at(channel)->setData(new WaveformData(spectrum));
+
+    double maxFreq = 0.0;
+    foreach (QwtPlotCurve* curve, spectra_) {
+        if (curve->isVisible() && curve->dataSize() > 0)
+            maxFreq = qMax(maxFreq, curve->sample(curve->dataSize() - 1).x());
+    }
+
+    if (maxFreq > 0.0)
+        freqPlot_->setAxisScale(QwtPlot::xBottom, 0, maxFreq, maxFreq / 10.0);
+
+    freqPlot_->replot();
+}
+
+// Shows or hides the spectrum plot, the spectrum is only calculated while
+// it is shown.
+void Plot::setSpectrumEnabled(bool enabled) {
+    state_->setSpectrumEnabled(enabled);
+
+    if (freqPlot_ == NULL)
+        return;
+
+    if (!enabled) {
+        foreach (QwtPlotCurve* curve, spectra_) {
+            curve->setData(new WaveformData(Waveform()));
+        }
+    }
+
+    freqPlot_->setVisible(enabled);
+}
+
+// Sets the window applied to each frame before its spectrum is calculated.
+void Plot::setSpectrumWindow(int window) {
+    state_->setSpectrumWindow((SpectrumWindow)window);
+}
+
+// Sets the number of frames the spectrum is averaged over.
+void Plot::setSpectrumAverages(int averages) {
+    state_->setSpectrumAverages(averages);
+}
+
+// Sets the rate the band-pass channel is decimated to, as an index into
+// bandpassRates.
+void Plot::setBandpassRate(int rate) {
+    state_->setBandpassRate(rate);
 }
 
 void Plot::plotAcquisition(int channel) {
-    if ((Channel)channel == A)
-        emit processA(*state_);
-    else if ((Channel)channel == B)
-        emit processB(*state_);
+    if ((Channel)channel == A || (Channel)channel == B)
+        request((Channel)channel);
+}
+
+// Returns an immutable snapshot of the current state to pass to the channel
+// threads. Only the State itself is allocated, its data is shared with
+// state_ until either is modified.
+StateSnapshot Plot::snapshot() const {
+    return StateSnapshot(new State(*state_));
 }
 
 void Plot::selectClosePoint() {
@@ -230,12 +408,14 @@ void Plot::solveEquation(QString equation) {
     }
 
     state_->setEquation(equation);
-    emit processM(*state_);
+    invalidated_[M] = true;
+    updateDerived();
     equationLabel_->setText(equation);
 }
 
 void Plot::calculateFilter() {
-    emit processF(*state_);
+    invalidated_[F] = true;
+    updateDerived();
 }
 
 void Plot::catchError(QString err) {
@@ -326,6 +506,39 @@ void Plot::setMarkerPlot(QwtPlot *markerPlot) {
     tMarker_->attach(markerPlot_);
 }
 
+// Sets the plot used to display the spectrum of each channel, and creates a
+// curve on it for each channel.
+void Plot::setSpectrumPlot(QwtPlot *spectrumPlot) {
+    freqPlot_ = spectrumPlot;
+
+    freqPlot_->plotLayout()->setCanvasMargin(0);
+    ((QwtPlotCanvas*)(freqPlot_->canvas()))->setStyleSheet("QwtPlotCanvas { border: 1px solid white; "
+                                              "border-radius: 0px; }");
+
+    freqPlot_->enableAxis(QwtPlot::xBottom, false);
+    freqPlot_->enableAxis(QwtPlot::yLeft, false);
+    freqPlot_->setAxisScale(QwtPlot::yLeft, -120, 20, 20);
+    freqPlot_->setAxisScale(QwtPlot::xBottom, 0, 1, 0.1);
+
+    QwtPlotGrid *grid = new QwtPlotGrid();
+    grid->setPen( Qt::white, 0.0, Qt::DotLine );
+    grid->attach(freqPlot_);
+
+    QList<QColor> colours = {Qt::yellow, Qt::green, Qt::cyan, Qt::magenta};
+
+    for (int i = 0; i < colours.size(); i++) {
+        QwtPlotCurve* curve = new QwtPlotCurve();
+        curve->setItemAttribute(QwtPlotItem::AutoScale, false);
+        curve->setPaintAttribute(QwtPlotCurve::FilterPoints, true);
+        curve->setPen(colours.at(i), 1.0);
+        curve->setVisible(i == A || i == B);
+        curve->attach(freqPlot_);
+        spectra_.append(curve);
+    }
+
+    freqPlot_->setVisible(state_->spectrumEnabled());
+}
+
 void Plot::setEquationLabel(QLabel* label) {
     equationLabel_ = label;
 }
@@ -384,6 +597,11 @@ void Plot::setCurveVisible(Channel channel, bool visible) {
             break;
     }
 
+    if (freqPlot_ != NULL) {
+        spectra_.at(channel)->setVisible(visible);
+        freqPlot_->replot();
+    }
+
     replot();
 }
 
@@ -545,9 +763,7 @@ void Plot::styleCanvas() {
     y0Marker_->attach(this);
 }
 
+// Waits for the frames being processed to finish before closing.
 void Plot::exit() {
-    aThread_->quit();
-    bThread_->quit();
-    fThread_->quit();
-    mThread_->quit();
+    QThreadPool::globalInstance()->waitForDone();
 }
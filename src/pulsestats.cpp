@@ -0,0 +1,162 @@
+#include "pulsestats.h"
+
+// Returns the position, in samples, at which the line between the sample a
+// at i and the sample b at j crosses the level.
+static inline double crossing(int i, int j, float a, float b, double level) {
+    return i + (level - a) / (b - a) * (j - i);
+}
+
+// Returns the mean of the samples in the most populated bin of the histogram
+// between the first and last bins given.
+static double histogramMode(const int* histogram, const double* sums, int first, int last) {
+    int mode = first;
+
+    for (int i = first + 1; i <= last; i++) {
+        if (histogram[i] > histogram[mode])
+            mode = i;
+    }
+
+    return sums[mode] / histogram[mode];
+}
+
+// Measures the pulses of count samples taken timeStep milliseconds apart, in
+// a single pass, given the minimum and maximum of the samples. Edges are
+// found at 10%, 50% and 90% of the range between the minimum and maximum,
+// and the top and base levels are the most common voltages in the upper and
+// lower halves of that range. Rise and fall times are measured between the
+// 10% and 90% crossings of each edge, widths between 50% crossings, and the
+// frequency, duty cycle and cycle RMS over the whole periods between the
+// first and last rising edges.
+PulseStats measurePulses(const float* y, int count, double timeStep, float min, float max) {
+    PulseStats stats = {0, 0.0, -1.0, -1.0, -1.0, -1.0, -1.0, max, min, 0.0, 0.0, 0.0};
+
+    double range = max - min;
+    if (count < 3 || !qIsFinite(range) || range <= 0.0 || timeStep <= 0.0)
+        return stats;
+
+    double low = min + 0.1 * range;
+    double mid = min + 0.5 * range;
+    double high = min + 0.9 * range;
+    double upper = mid + 0.5 * PULSE_HYSTERESIS * range;
+    double lower = mid - 0.5 * PULSE_HYSTERESIS * range;
+
+    int histogram[PULSE_HISTOGRAM_BINS] = {0};
+    double binSums[PULSE_HISTOGRAM_BINS] = {0.0};
+    double binScale = PULSE_HISTOGRAM_BINS / range;
+
+    bool above = false;
+    double lowUp = 0.0, highDown = 0.0, midUp = -1.0, midDown = -1.0;
+    bool rising = false, falling = false;
+
+    int rises = 0, riseEdges = 0, fallEdges = 0, positive = 0, negative = 0;
+    double firstRise = 0.0, lastRise = 0.0, fall = -1.0, highTime = 0.0;
+    double riseSum = 0.0, fallSum = 0.0, positiveSum = 0.0, negativeSum = 0.0;
+    double squares = 0.0, firstSquares = 0.0, lastSquares = 0.0;
+    int samples = 0, firstIndex = 0, lastIndex = 0, last = -1;
+
+    for (int i = 0; i < count; i++) {
+        float v = y[i];
+
+        // Samples the math channel could not calculate, such as a division
+        // by zero, are skipped and edges are found between the samples
+        // either side of them.
+        if (!qIsFinite(v))
+            continue;
+
+        int bin = qBound(0, (int)((v - min) * binScale), PULSE_HISTOGRAM_BINS - 1);
+        histogram[bin]++;
+        binSums[bin] += v;
+
+        if (last < 0) {
+            above = v > mid;
+        } else {
+            float u = y[last];
+
+            // Edges between the 10% and 90% levels.
+            if (u < low && v >= low) {
+                lowUp = crossing(last, i, u, v, low);
+                rising = true;
+            }
+            if (rising && u < high && v >= high) {
+                riseSum += crossing(last, i, u, v, high) - lowUp;
+                riseEdges++;
+                rising = false;
+            }
+            if (u > high && v <= high) {
+                highDown = crossing(last, i, u, v, high);
+                falling = true;
+            }
+            if (falling && u > low && v <= low) {
+                fallSum += crossing(last, i, u, v, low) - highDown;
+                fallEdges++;
+                falling = false;
+            }
+
+            // Crossings of the midpoint, counted once the hysteresis band is
+            // passed.
+            if (u < mid && v >= mid) midUp = crossing(last, i, u, v, mid);
+            if (u >= mid && v < mid) midDown = crossing(last, i, u, v, mid);
+
+            if (!above && v >= upper && midUp >= 0.0) {
+                above = true;
+                double t = midUp;
+
+                if (fall >= 0.0) {
+                    negativeSum += t - fall;
+                    negative++;
+                }
+
+                if (rises == 0) {
+                    firstRise = t;
+                    firstIndex = samples;
+                    firstSquares = squares;
+                } else if (fall > lastRise) {
+                    highTime += fall - lastRise;
+                }
+
+                lastRise = t;
+                lastIndex = samples;
+                lastSquares = squares;
+                rises++;
+            } else if (above && v <= lower && midDown >= 0.0) {
+                above = false;
+                fall = midDown;
+
+                if (rises > 0) {
+                    positiveSum += fall - lastRise;
+                    positive++;
+                }
+            }
+        }
+
+        squares += (double)v * v;
+        samples++;
+        last = i;
+    }
+
+    // Convert from samples to seconds, the time axis is in milliseconds.
+    double seconds = timeStep / 1000.0;
+
+    if (riseEdges > 0) stats.riseTime = riseSum / riseEdges * seconds;
+    if (fallEdges > 0) stats.fallTime = fallSum / fallEdges * seconds;
+    if (positive > 0) stats.positiveWidth = positiveSum / positive * seconds;
+    if (negative > 0) stats.negativeWidth = negativeSum / negative * seconds;
+
+    if (rises >= 2) {
+        double span = lastRise - firstRise;
+        stats.periods = rises - 1;
+        stats.frequency = stats.periods / (span * seconds);
+        stats.dutyCycle = highTime / span;
+        stats.cycleRms = qSqrt((lastSquares - firstSquares) / (lastIndex - firstIndex));
+    }
+
+    stats.base = histogramMode(histogram, binSums, 0, PULSE_HISTOGRAM_BINS / 2 - 1);
+    stats.top = histogramMode(histogram, binSums, PULSE_HISTOGRAM_BINS / 2,
+                              PULSE_HISTOGRAM_BINS - 1);
+
+    double amplitude = stats.top - stats.base;
+    stats.overshoot = qMax(0.0, (max - stats.top) / amplitude * 100.0);
+    stats.undershoot = qMax(0.0, (stats.base - min) / amplitude * 100.0);
+
+    return stats;
+}
@@ -0,0 +1,194 @@
+#include "samplestats.h"
+
+// Partial results of a block of samples.
+struct BlockStats
+{
+    float min, max;
+    double sum, sumSquares;
+    int clippedLow, clippedHigh;
+};
+
+// Reduces count samples starting at y into the partial results of a block.
+static void reduceScalar(const float* y, int count, float low, float high, BlockStats* block) {
+    for (int i = 0; i < count; i++) {
+        float v = y[i];
+        if (v < block->min) block->min = v;
+        if (v > block->max) block->max = v;
+        block->sum += v;
+        block->sumSquares += (double)v * v;
+        if (v <= low) block->clippedLow++;
+        if (v >= high) block->clippedHigh++;
+    }
+}
+
+#ifdef __SSE2__
+// SSE2 kernel, reduces 4 samples per iteration. Returns the number of
+// samples reduced.
+static int reduceSse2(const float* y, int count, float low, float high, BlockStats* block) {
+    __m128 vMin = _mm_set1_ps(block->min);
+    __m128 vMax = _mm_set1_ps(block->max);
+    __m128 vLow = _mm_set1_ps(low);
+    __m128 vHigh = _mm_set1_ps(high);
+    __m128d sum = _mm_setzero_pd();
+    __m128d sumSquares = _mm_setzero_pd();
+    __m128i clippedLow = _mm_setzero_si128();
+    __m128i clippedHigh = _mm_setzero_si128();
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_loadu_ps(y + i);
+        vMin = _mm_min_ps(vMin, v);
+        vMax = _mm_max_ps(vMax, v);
+
+        __m128d lo = _mm_cvtps_pd(v);
+        __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+        sum = _mm_add_pd(sum, _mm_add_pd(lo, hi));
+        sumSquares = _mm_add_pd(sumSquares, _mm_add_pd(_mm_mul_pd(lo, lo), _mm_mul_pd(hi, hi)));
+
+        // Comparisons give -1 in each lane that is clipped.
+        clippedLow = _mm_sub_epi32(clippedLow, _mm_castps_si128(_mm_cmple_ps(v, vLow)));
+        clippedHigh = _mm_sub_epi32(clippedHigh, _mm_castps_si128(_mm_cmpge_ps(v, vHigh)));
+    }
+
+    float mins[4], maxs[4];
+    double sums[2], squares[2];
+    qint32 lows[4], highs[4];
+    _mm_storeu_ps(mins, vMin);
+    _mm_storeu_ps(maxs, vMax);
+    _mm_storeu_pd(sums, sum);
+    _mm_storeu_pd(squares, sumSquares);
+    _mm_storeu_si128((__m128i*)lows, clippedLow);
+    _mm_storeu_si128((__m128i*)highs, clippedHigh);
+
+    for (int j = 0; j < 4; j++) {
+        block->min = qMin(block->min, mins[j]);
+        block->max = qMax(block->max, maxs[j]);
+        block->clippedLow += lows[j];
+        block->clippedHigh += highs[j];
+    }
+
+    block->sum += sums[0] + sums[1];
+    block->sumSquares += squares[0] + squares[1];
+
+    return i;
+}
+#endif
+
+#ifdef SIMD_AVX2_DISPATCH
+// AVX2 kernel, reduces 8 samples per iteration. Returns the number of
+// samples reduced.
+SIMD_TARGET_AVX2
+static int reduceAvx2(const float* y, int count, float low, float high, BlockStats* block) {
+    __m256 vMin = _mm256_set1_ps(block->min);
+    __m256 vMax = _mm256_set1_ps(block->max);
+    __m256 vLow = _mm256_set1_ps(low);
+    __m256 vHigh = _mm256_set1_ps(high);
+    __m256d sum = _mm256_setzero_pd();
+    __m256d sumSquares = _mm256_setzero_pd();
+    __m256i clippedLow = _mm256_setzero_si256();
+    __m256i clippedHigh = _mm256_setzero_si256();
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_loadu_ps(y + i);
+        vMin = _mm256_min_ps(vMin, v);
+        vMax = _mm256_max_ps(vMax, v);
+
+        __m256d lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+        __m256d hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+        sum = _mm256_add_pd(sum, _mm256_add_pd(lo, hi));
+        sumSquares = _mm256_fmadd_pd(lo, lo, sumSquares);
+        sumSquares = _mm256_fmadd_pd(hi, hi, sumSquares);
+
+        // Comparisons give -1 in each lane that is clipped.
+        clippedLow = _mm256_sub_epi32(clippedLow,
+                                      _mm256_castps_si256(_mm256_cmp_ps(v, vLow, _CMP_LE_OQ)));
+        clippedHigh = _mm256_sub_epi32(clippedHigh,
+                                       _mm256_castps_si256(_mm256_cmp_ps(v, vHigh, _CMP_GE_OQ)));
+    }
+
+    float mins[8], maxs[8];
+    double sums[4], squares[4];
+    qint32 lows[8], highs[8];
+    _mm256_storeu_ps(mins, vMin);
+    _mm256_storeu_ps(maxs, vMax);
+    _mm256_storeu_pd(sums, sum);
+    _mm256_storeu_pd(squares, sumSquares);
+    _mm256_storeu_si256((__m256i*)lows, clippedLow);
+    _mm256_storeu_si256((__m256i*)highs, clippedHigh);
+
+    for (int j = 0; j < 8; j++) {
+        block->min = qMin(block->min, mins[j]);
+        block->max = qMax(block->max, maxs[j]);
+        block->clippedLow += lows[j];
+        block->clippedHigh += highs[j];
+    }
+
+    block->sum += sums[0] + sums[1] + sums[2] + sums[3];
+    block->sumSquares += squares[0] + squares[1] + squares[2] + squares[3];
+
+    return i;
+}
+#endif
+
+// Reduces the leading samples of a block with the fastest available vector
+// kernel, returning the number of samples reduced.
+static int reduceVector(const float* y, int count, float low, float high, BlockStats* block) {
+#ifdef SIMD_AVX2_DISPATCH
+    if (cpuHasAvx2())
+        return reduceAvx2(y, count, low, high, block);
+#endif
+#ifdef __SSE2__
+    return reduceSse2(y, count, low, high, block);
+#else
+    return 0;
+#endif
+}
+
+// Reduces a block of samples, finishing the samples left over by the vector
+// kernel with the scalar one.
+static void reduce(const float* y, int count, float low, float high, BlockStats* block) {
+    int done = reduceVector(y, count, low, high, block);
+    reduceScalar(y + done, count - done, low, high, block);
+}
+
+// Returns the statistics of count samples in a single pass. Each block is
+// reduced to its sum and sum of squares, which are merged into the running
+// mean and variance with Welford's update generalised to blocks (Chan et
+// al.), so the variance keeps its precision over long frames.
+SampleStats measureSamples(const float* y, int count, float low, float high) {
+    SampleStats stats = {0, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    if (count <= 0) return stats;
+
+    float min = y[0], max = y[0];
+    double mean = 0.0, m2 = 0.0, sumSquares = 0.0;
+
+    for (int start = 0; start < count; start += STATS_BLOCK_SIZE) {
+        int n = qMin(STATS_BLOCK_SIZE, count - start);
+        BlockStats block = {y[start], y[start], 0.0, 0.0, 0, 0};
+        reduce(y + start, n, low, high, &block);
+
+        min = qMin(min, block.min);
+        max = qMax(max, block.max);
+        stats.clippedLow += block.clippedLow;
+        stats.clippedHigh += block.clippedHigh;
+        sumSquares += block.sumSquares;
+
+        double blockMean = block.sum / n;
+        double blockM2 = qMax(block.sumSquares - block.sum * blockMean, 0.0);
+        int total = stats.count + n;
+        double delta = blockMean - mean;
+
+        mean += delta * n / total;
+        m2 += blockM2 + delta * delta * ((double)stats.count * n / total);
+        stats.count = total;
+    }
+
+    stats.min = min;
+    stats.max = max;
+    stats.mean = mean;
+    stats.variance = m2 / count;
+    stats.rms = qSqrt(sumSquares / count);
+
+    return stats;
+}
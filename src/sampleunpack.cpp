@@ -0,0 +1,85 @@
+#include "sampleunpack.h"
+
+#ifdef SIMD_AVX2_DISPATCH
+// AVX2 kernel, byte swaps and masks 16 samples per iteration. Returns the
+// number of samples unpacked.
+SIMD_TARGET_AVX2
+static int unpackTwelveBitAvx2(const uchar* src, quint16* dst, int count) {
+    const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                                          9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6,
+                                          9, 8, 11, 10, 13, 12, 15, 14);
+    const __m256i mask = _mm256_set1_epi16(0x0FFF);
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + 2 * i));
+        v = _mm256_and_si256(_mm256_shuffle_epi8(v, swap), mask);
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+
+    return i;
+}
+
+// AVX2 kernel, zero extends 16 samples per iteration. Returns the number of
+// samples unpacked.
+SIMD_TARGET_AVX2
+static int unpackEightBitAvx2(const uchar* src, quint16* dst, int count) {
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_cvtepu8_epi16(v));
+    }
+
+    return i;
+}
+#endif
+
+// Unpacks count big endian 12 bit samples, each stored in 2 bytes.
+void unpackTwelveBit(const uchar* src, quint16* dst, int count) {
+    int i = 0;
+
+#ifdef SIMD_AVX2_DISPATCH
+    if (cpuHasAvx2())
+        i = unpackTwelveBitAvx2(src, dst, count);
+#endif
+
+#ifdef __SSE2__
+    const __m128i mask = _mm_set1_epi16(0x0FFF);
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + 2 * i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_and_si128(v, mask));
+    }
+#endif
+
+    for (; i < count; i++) {
+        dst[i] = (quint16)(((src[2 * i] << 8) | src[2 * i + 1]) & 0x0FFF);
+    }
+}
+
+// Unpacks count 8 bit samples, each stored in 1 byte.
+void unpackEightBit(const uchar* src, quint16* dst, int count) {
+    int i = 0;
+
+#ifdef SIMD_AVX2_DISPATCH
+    if (cpuHasAvx2())
+        i = unpackEightBitAvx2(src, dst, count);
+#endif
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+#endif
+
+    for (; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
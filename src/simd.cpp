@@ -0,0 +1,127 @@
+#include "simd.h"
+
+// Returns true if AVX2 and FMA kernels can be used on this machine. The CPU
+// is only queried once.
+bool cpuHasAvx2() {
+#ifdef SIMD_AVX2_DISPATCH
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2")
+            && __builtin_cpu_supports("fma");
+    return hasAvx2;
+#else
+    return false;
+#endif
+}
+
+// Scalar dot product.
+static double dotScalar(const double* a, const double* b, int count) {
+    double sum = 0.0;
+
+    for (int i = 0; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+
+    return sum;
+}
+
+#ifdef __SSE2__
+// SSE2 dot product, two accumulators of two values each.
+static double dotSse2(const double* a, const double* b, int count) {
+    __m128d sum0 = _mm_setzero_pd();
+    __m128d sum1 = _mm_setzero_pd();
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+
+    double partial[2];
+    _mm_storeu_pd(partial, _mm_add_pd(sum0, sum1));
+
+    return partial[0] + partial[1] + dotScalar(a + i, b + i, count - i);
+}
+#endif
+
+#ifdef SIMD_AVX2_DISPATCH
+// AVX2 dot product, two fused multiply-add accumulators of four values each.
+SIMD_TARGET_AVX2
+static double dotAvx2(const double* a, const double* b, int count) {
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), sum0);
+        sum1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4), sum1);
+    }
+
+    double partial[4];
+    _mm256_storeu_pd(partial, _mm256_add_pd(sum0, sum1));
+
+    return partial[0] + partial[1] + partial[2] + partial[3]
+            + dotScalar(a + i, b + i, count - i);
+}
+#endif
+
+// Returns the dot product of two arrays using the fastest available kernel.
+double dotProduct(const double* a, const double* b, int count) {
+#ifdef SIMD_AVX2_DISPATCH
+    if (cpuHasAvx2())
+        return dotAvx2(a, b, count);
+#endif
+#ifdef __SSE2__
+    return dotSse2(a, b, count);
+#else
+    return dotScalar(a, b, count);
+#endif
+}
+
+// Scalar element-wise multiplication.
+static void multiplyScalar(double* a, const double* b, int count) {
+    for (int i = 0; i < count; i++) {
+        a[i] *= b[i];
+    }
+}
+
+#ifdef __SSE2__
+// SSE2 element-wise multiplication, two values at a time.
+static void multiplySse2(double* a, const double* b, int count) {
+    int i = 0;
+
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_pd(a + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+
+    multiplyScalar(a + i, b + i, count - i);
+}
+#endif
+
+#ifdef SIMD_AVX2_DISPATCH
+// AVX2 element-wise multiplication, four values at a time.
+SIMD_TARGET_AVX2
+static void multiplyAvx2(double* a, const double* b, int count) {
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(a + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+
+    multiplyScalar(a + i, b + i, count - i);
+}
+#endif
+
+// Multiplies each value of a by the value of b at the same index using the
+// fastest available kernel.
+void multiplyInPlace(double* a, const double* b, int count) {
+#ifdef SIMD_AVX2_DISPATCH
+    if (cpuHasAvx2()) {
+        multiplyAvx2(a, b, count);
+        return;
+    }
+#endif
+#ifdef __SSE2__
+    multiplySse2(a, b, count);
+#else
+    multiplyScalar(a, b, count);
+#endif
+}
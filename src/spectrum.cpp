@@ -0,0 +1,123 @@
+#include "spectrum.h"
+
+Spectrum::Spectrum()
+{
+    windowType_ = HANN;
+    windowSum_ = 0.0;
+    binWidth_ = 0.0;
+    frames_ = 0;
+}
+
+// Returns the spectrum of the signal as a waveform whose time axis is the
+// frequency of each bin in Hz and whose values are the amplitude of each
+// bin in dBV. Consecutive calls are averaged over the given number of frames.
+Waveform Spectrum::calculate(const Waveform& signal, SpectrumWindow window, int averages) {
+    int size = signal.size();
+    if (size < 2 || signal.timeStep() <= 0.0) {
+        reset();
+        return Waveform();
+    }
+
+    // The time axis is in milliseconds.
+    double binWidth = 1000.0 / (size * signal.timeStep());
+    int bins = size / 2 + 1;
+
+    if (window != windowType_ || size != window_.size())
+        prepareWindow(window, size);
+
+    if (binWidth != binWidth_ || bins != power_.size()) {
+        power_.fill(0.0, bins);
+        binWidth_ = binWidth;
+        frames_ = 0;
+    }
+
+    const FftPlan* transform = FftPlanCache::local()->plan(size);
+    const float* y = signal.constData();
+    const double* w = window_.constData();
+    double* input = transform->input;
+
+    for (int i = 0; i < size; i++) {
+        input[i] = y[i] * w[i];
+    }
+
+    fftw_execute(transform->plan);
+
+    // Average the power of each bin, as a running mean over the first frames
+    // and an exponential average once the requested number is reached.
+    if (frames_ < averages) frames_++;
+    double weight = 1.0 / qMin(frames_, qMax(averages, 1));
+
+    // Scale so that a sinusoid reads its peak amplitude in its bin.
+    double scale = 2.0 / windowSum_;
+    const fftw_complex* spectrum = transform->spectrum;
+    double* power = power_.data();
+
+    Waveform result(0.0, binWidth, bins);
+    float* values = result.data();
+
+    for (int k = 0; k < bins; k++) {
+        double re = spectrum[k][0] * scale;
+        double im = spectrum[k][1] * scale;
+        double p = re * re + im * im;
+
+        if (k == 0 || 2 * k == size) p *= 0.25;
+
+        power[k] += (p - power[k]) * weight;
+
+        values[k] = (power[k] > 0.0) ? qMax(10.0 * log10(power[k]), SPECTRUM_FLOOR_DB)
+                                     : SPECTRUM_FLOOR_DB;
+    }
+
+    return result;
+}
+
+// Discards the averaged spectrum.
+void Spectrum::reset() {
+    power_.clear();
+    binWidth_ = 0.0;
+    frames_ = 0;
+}
+
+// Calculates the coefficients of the window for frames of the given size.
+void Spectrum::prepareWindow(SpectrumWindow type, int size) {
+    static const double hann[] = {0.5, 0.5};
+    static const double blackman[] = {0.42, 0.5, 0.08};
+    static const double flatTop[] = {0.21557895, 0.41663158, 0.277263158,
+                                     0.083578947, 0.006947368};
+
+    const double* a;
+    int terms;
+
+    switch (type) {
+        case BLACKMAN:
+            a = blackman;
+            terms = 3;
+            break;
+        case FLAT_TOP:
+            a = flatTop;
+            terms = 5;
+            break;
+        default:
+            a = hann;
+            terms = 2;
+            break;
+    }
+
+    window_.resize(size);
+    windowSum_ = 0.0;
+
+    for (int i = 0; i < size; i++) {
+        double phase = 2.0 * M_PI * i / size;
+        double value = a[0];
+
+        for (int j = 1; j < terms; j++) {
+            value += ((j % 2) ? -a[j] : a[j]) * qCos(j * phase);
+        }
+
+        window_[i] = value;
+        windowSum_ += value;
+    }
+
+    windowType_ = type;
+    power_.clear();
+}
@@ -32,6 +32,12 @@ State::State()
     filterChannel_ = A;   
     filterEnabled_ = false;
 
+    spectrumEnabled_ = false;
+    spectrumWindow_ = HANN;
+    spectrumAverages_ = 1;
+
+    bandpassRate_ = DEFAULT_BANDPASS_RATE;
+
     int currentFreq = 1;
     for (int i = 1; i < 431; i++) {
         functionFreqs_.append(currentFreq);
@@ -43,52 +49,13 @@ State::State()
             currentFreq += 100;
         }
     }
+
+    aAcquisition_.reserve(noSamples_);
+    bAcquisition_.reserve(noSamples_);
 }
 
 State::~State() { }
 
-// Public copy constructor.
-State::State(const State &state) {
-    noSamples_ = state.getNoSamples();
-    aOffset_ = state.getChannelOffset(A);
-    bOffset_ = state.getChannelOffset(B);
-    triggerThreshold_ = state.getTriggerThreshold();
-    triggerState_ = state.getTriggerState();
-    bitMode_ = state.getBitMode();
-    aDiv_ = state.getVoltageDiv(A);
-    bDiv_ = state.getVoltageDiv(B);
-    fDiv_ = state.getVoltageDiv(F);
-    mDiv_ = state.getVoltageDiv(M);
-    hDiv_ = state.getTimeDiv();
-    functionVoltage_ = state.getFunctionVoltage();
-    aFilterMode_ = state.getFilterMode();
-    aCouplingType_ = state.getCouplingType(A);
-    bCouplingType_ = state.getCouplingType(B);
-    triggerChannel_ = state.getTriggerChannel();
-    triggerMode_ = state.getTriggerMode();
-    triggerType_ = state.getTriggerType();
-    aData_ = state.getPlotPoints(A);
-    bData_ = state.getPlotPoints(B);
-    fData_ = state.getPlotPoints(F);
-    mData_ = state.getPlotPoints(M);
-    functionState_ = state.getFunctionState();
-    functionWave_ = state.getWaveType();
-    functionOffset_ = state.getFunctionOffset();
-    functionFreq_ = state.getFunctionFreq();
-    aAcquisition_ = state.getAcquisition(A);
-    bAcquisition_ = state.getAcquisition(B);
-    filterChannel_ = state.getFilterChannel();
-    filterEnabled_ = state.filterEnabled();
-    aTaps_ = state.getATaps();
-    bTaps_ = state.getBTaps();
-    filterType_ = state.getFilterType();
-    equation_ = state.getEquation();
-    triggerForced_ = state.triggerForced();
-    triggerIndex_ = state.getTriggerIndex();
-
-    functionFreqs_ = state.functionFreqs_;
-}
-
 // Returns the current number of samples.
 quint16 State::getNoSamples() const {
     return noSamples_;
@@ -97,6 +64,8 @@ quint16 State::getNoSamples() const {
 // Sets the current number of samples.
 void State::setNoSamples(quint16 noSamples) {
     noSamples_ = noSamples;
+    aAcquisition_.reserve(noSamples_);
+    bAcquisition_.reserve(noSamples_);
 }
 
 // Gets the current bit mode.
@@ -236,7 +205,7 @@ void State::setTriggerType(TriggerType type) {
 }
 
 // Returns the plot points of the specified channel.
-QVector<QPointF> State::getPlotPoints(Channel channel) const {
+Waveform State::getPlotPoints(Channel channel) const {
     switch(channel) {
         case A:
             return aData_;
@@ -250,7 +219,7 @@ QVector<QPointF> State::getPlotPoints(Channel channel) const {
 }
 
 // Sets the plot points of the specified channel.
-void State::setPlotPoints(Channel channel, QVector<QPointF> data) {
+void State::setPlotPoints(Channel channel, const Waveform& data) {
     switch(channel) {
         case A:
             aData_ = data;
@@ -335,31 +304,31 @@ void State::setFunctionFreq(quint16 freq) {
     functionFreq_ = freq;
 }
 
-// Returns the acquisition of the specified channel.
-QList<quint16> State::getAcquisition(Channel channel) const {
-    if (channel == A) {
-        return aAcquisition_;
-    } else {
-        return bAcquisition_;
-    }
+// Returns a read-only view of the acquisition of the specified channel.
+SampleSpan<quint16> State::getAcquisition(Channel channel) const {
+    const QVector<quint16>& acquisition = (channel == A) ? aAcquisition_ : bAcquisition_;
+    return SampleSpan<quint16>(acquisition.constData(), acquisition.size());
 }
 
-// Sets the acquisition of the specified channel.
-void State::setAcquisition(Channel channel, QList<quint16> data) {
-    if (channel == A) {
-        aAcquisition_.append(data);
-    } else {
-        bAcquisition_.append(data);
-    }
+// Appends count samples to the acquisition of the specified channel. The
+// buffer is sized from the number of samples so a full capture is received
+// without reallocating.
+void State::setAcquisition(Channel channel, const quint16* data, int count) {
+    QVector<quint16>& acquisition = (channel == A) ? aAcquisition_ : bAcquisition_;
+    int size = acquisition.size();
+
+    if (acquisition.capacity() < qMax((int)noSamples_, size + count))
+        acquisition.reserve(qMax((int)noSamples_, size + count));
+
+    acquisition.resize(size + count);
+    memcpy(acquisition.data() + size, data, count * sizeof(quint16));
 }
 
-// Clears the acquisition of the specified channel.
+// Clears the acquisition of the specified channel, keeping its storage for
+// the next capture.
 void State::clearAcquisition(Channel channel) {
-    if (channel == A) {
-        aAcquisition_.clear();
-    } else {
-        bAcquisition_.clear();
-    }
+    QVector<quint16>& acquisition = (channel == A) ? aAcquisition_ : bAcquisition_;
+    acquisition.resize(0);
 }
 
 // Returns true if the most recent trigger event was forced.
@@ -402,6 +371,16 @@ void State::setBTaps(QList<double> taps) {
     bTaps_ = taps;
 }
 
+// Returns the IIR filter factored into second order sections.
+BiquadCascade State::getSections() const {
+    return sections_;
+}
+
+// Sets the IIR filter factored into second order sections.
+void State::setSections(const BiquadCascade& sections) {
+    sections_ = sections;
+}
+
 // Returns the channel currently being filtered.
 Channel State::getFilterChannel() const {
     return filterChannel_;
@@ -441,3 +420,43 @@ QString State::getEquation() const {
 void State::setEquation(QString equation) {
     equation_ = equation;
 }
+
+// Returns true if the spectrum of each channel is being calculated.
+bool State::spectrumEnabled() const {
+    return spectrumEnabled_;
+}
+
+// Sets whether the spectrum of each channel is calculated.
+void State::setSpectrumEnabled(bool enabled) {
+    spectrumEnabled_ = enabled;
+}
+
+// Returns the window applied before calculating the spectrum.
+SpectrumWindow State::getSpectrumWindow() const {
+    return spectrumWindow_;
+}
+
+// Sets the window applied before calculating the spectrum.
+void State::setSpectrumWindow(SpectrumWindow window) {
+    spectrumWindow_ = window;
+}
+
+// Returns the number of frames the spectrum is averaged over.
+int State::getSpectrumAverages() const {
+    return spectrumAverages_;
+}
+
+// Sets the number of frames the spectrum is averaged over.
+void State::setSpectrumAverages(int averages) {
+    spectrumAverages_ = averages;
+}
+
+// Returns the index of the rate the band-pass channel is decimated to.
+int State::getBandpassRate() const {
+    return bandpassRate_;
+}
+
+// Sets the index of the rate the band-pass channel is decimated to.
+void State::setBandpassRate(int rate) {
+    bandpassRate_ = rate;
+}
@@ -0,0 +1,35 @@
+#include "waveform.h"
+
+Waveform::Waveform(double startTime, double timeStep, int size) :
+    y_(size)
+{
+    t0_ = startTime;
+    dt_ = timeStep;
+}
+
+// Returns the time of the last sample, or the start time if the waveform
+// is empty.
+double Waveform::endTime() const {
+    return y_.isEmpty() ? t0_ : time(y_.size() - 1);
+}
+
+// Sets the time of the first sample and the time between samples.
+void Waveform::setTiming(double startTime, double timeStep) {
+    t0_ = startTime;
+    dt_ = timeStep;
+}
+
+// Resizes the waveform to hold the given number of samples.
+void Waveform::resize(int size) {
+    y_.resize(size);
+}
+
+// Reserves space for the given number of samples.
+void Waveform::reserve(int size) {
+    y_.reserve(size);
+}
+
+// Removes all samples from the waveform, keeping its timing.
+void Waveform::clear() {
+    y_.clear();
+}
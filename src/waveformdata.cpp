@@ -0,0 +1,44 @@
+#include "waveformdata.h"
+
+WaveformData::WaveformData(const Waveform& waveform) :
+    waveform_(waveform)
+{
+
+}
+
+// Returns the waveform presented by this series.
+const Waveform& WaveformData::waveform() const {
+    return waveform_;
+}
+
+// Returns the number of points in the series.
+size_t WaveformData::size() const {
+    return (size_t)waveform_.size();
+}
+
+// Returns the point at index i.
+QPointF WaveformData::sample(size_t i) const {
+    return QPointF(waveform_.time((int)i), waveform_.value((int)i));
+}
+
+// Returns the bounding rectangle of the series, calculated on first use.
+QRectF WaveformData::boundingRect() const {
+    if (d_boundingRect.width() < 0.0) {
+        if (waveform_.isEmpty())
+            return d_boundingRect;
+
+        const float* y = waveform_.constData();
+        float minY = y[0], maxY = y[0];
+
+        for (int i = 1; i < waveform_.size(); i++) {
+            minY = qMin(minY, y[i]);
+            maxY = qMax(maxY, y[i]);
+        }
+
+        d_boundingRect = QRectF(waveform_.startTime(), minY,
+                                waveform_.endTime() - waveform_.startTime(),
+                                maxY - minY);
+    }
+
+    return d_boundingRect;
+}